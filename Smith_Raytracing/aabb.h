@@ -0,0 +1,74 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+
+#include <utility>
+
+/**
+ * \brief Axis-aligned bounding box, used to cull rays before testing the primitives inside it
+ */
+struct Aabb
+{
+	// - Members - //
+	point3 Min_;
+	point3 Max_;
+
+	// - Constructors - //
+	Aabb()
+		: Min_(static_cast<float>(infinity), static_cast<float>(infinity), static_cast<float>(infinity)),
+		  Max_(-static_cast<float>(infinity), -static_cast<float>(infinity), -static_cast<float>(infinity)) {} // empty box, grows with Extend()
+	Aabb(const point3& _min, const point3& _max) : Min_(_min), Max_(_max) {}
+
+	// - Methods - //
+	void Extend(const point3& _p) {
+		for (int a = 0; a < 3; ++a)
+		{
+			Min_[a] = fmin(Min_[a], _p[a]);
+			Max_[a] = fmax(Max_[a], _p[a]);
+		}
+	}
+	void Extend(const Aabb& _box) {
+		// per axis rather than via the corners, so extending by an empty box leaves this one unchanged
+		for (int a = 0; a < 3; ++a)
+		{
+			Min_[a] = fmin(Min_[a], _box.Min_[a]);
+			Max_[a] = fmax(Max_[a], _box.Max_[a]);
+		}
+	}
+	point3 Centroid() const { return 0.5f * (Min_ + Max_); }
+	/**
+	 * \return index (0, 1, 2) of the axis along which the box is widest
+	 */
+	int LongestAxis() const {
+		const Vec3 extent = Max_ - Min_;
+		if (extent.X() > extent.Y() && extent.X() > extent.Z())
+			return 0;
+		return extent.Y() > extent.Z() ? 1 : 2;
+	}
+
+	/**
+	 * \brief Slab test: does the ray pass through the box somewhere in [_tMin, _tMax]?
+	 * \param _r incoming Ray
+	 * \param _invDir 1 / _r.Direction(), per component (precomputed once per traversal)
+	 * \param _tMin lower bounds of the valid interval
+	 * \param _tMax upper bounds of the valid interval
+	 */
+	bool Hit(const Ray& _r, const Vec3& _invDir, float _tMin, float _tMax) const {
+		for (int a = 0; a < 3; ++a)
+		{
+			float t0 = (Min_[a] - _r.Origin_[a]) * _invDir[a];
+			float t1 = (Max_[a] - _r.Origin_[a]) * _invDir[a];
+			if (_invDir[a] < 0.0f)
+				std::swap(t0, t1);
+			t1 *= 1.0000004f; // 1 + 2 * gamma(3): widen the far side by the rounding error above so grazing rays aren't culled (Ize 2013)
+			_tMin = t0 > _tMin ? t0 : _tMin;
+			_tMax = t1 < _tMax ? t1 : _tMax;
+			if (_tMax < _tMin)
+				return false;
+		}
+		return true;
+	}
+};
+
+#endif
@@ -6,21 +6,19 @@
 
 #include "rtweekend.h"
 
-// Write (out stream) the translated [0,255] value of each color component
-inline void Write_Color(std::ostream& _out, colorRGB _pixelColor, int samplesPerPixel) {
-    auto r = _pixelColor.X();
-    auto g = _pixelColor.Y();
-    auto b = _pixelColor.Z();
-
-    // Divide the color by the number of samples and gamma-correct for gamma=2.0.
+// Scale an accumulated color by the number of samples and gamma-correct for gamma=2.0, giving [0,255] per component
+inline void To_Bytes(colorRGB _pixelColor, int samplesPerPixel, int& _r, int& _g, int& _b) {
     const auto scale = 1.0f / samplesPerPixel;
-    r = sqrt(scale * r);
-    g = sqrt(scale * g);
-    b = sqrt(scale * b);
+    _r = static_cast<int>(256 * Clamp(sqrt(scale * _pixelColor.X()), 0.0f, 0.999f));
+    _g = static_cast<int>(256 * Clamp(sqrt(scale * _pixelColor.Y()), 0.0f, 0.999f));
+    _b = static_cast<int>(256 * Clamp(sqrt(scale * _pixelColor.Z()), 0.0f, 0.999f));
+}
 
-	_out << static_cast<int>(256 * Clamp(r, 0.0f, 0.999f)) << ' '
-         << static_cast<int>(256 * Clamp(g, 0.0f, 0.999f)) << ' '
-         << static_cast<int>(256 * Clamp(b, 0.0f, 0.999f)) << '\n';
+// Write (out stream) the translated [0,255] value of each color component
+inline void Write_Color(std::ostream& _out, colorRGB _pixelColor, int samplesPerPixel) {
+    int r, g, b;
+    To_Bytes(_pixelColor, samplesPerPixel, r, g, b);
+	_out << r << ' ' << g << ' ' << b << '\n';
 }
 
 
@@ -0,0 +1,57 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <cstdint>
+#include <cstring>
+
+// Cheap replacements for the libm calls on the shading hot path.
+// Define RT_FAST_MATH when compiling to have vec3.h and material.h use them; without it they are only used by
+// the validation report (see FastMath_ErrorReport()), which measures how far each one is from the precise version.
+
+/**
+ * \brief 1 / sqrt(_x) for _x > 0: bit-trick estimate plus two Newton steps, max relative error ~5e-6
+ */
+inline float FastRsqrt(float _x) {
+	uint32_t bits;
+	std::memcpy(&bits, &_x, sizeof(bits));
+	bits = 0x5f375a86u - (bits >> 1);
+	float y;
+	std::memcpy(&y, &bits, sizeof(y));
+
+	const float halfX = 0.5f * _x;
+	y = y * (1.5f - halfX * y * y);
+	y = y * (1.5f - halfX * y * y);
+	return y;
+}
+
+/**
+ * \brief _x^5 with three multiplies instead of pow()
+ */
+inline float Pow5(float _x) {
+	const float x2 = _x * _x;
+	return x2 * x2 * _x;
+}
+
+/**
+ * \brief cos and sin of a full turn fraction: _cos = cos(2 pi _t), _sin = sin(2 pi _t), for _t in [0, 1).
+ *	Reduces to an eighth of a turn and uses short Taylor series there, max absolute error ~1e-7
+ */
+inline void FastSinCosTurns(float _t, float& _cos, float& _sin) {
+	const int quarter = static_cast<int>(_t * 4.0f + 0.5f);	// nearest quarter turn
+	const float x = 6.28318530718f * (_t - 0.25f * static_cast<float>(quarter));	// in [-pi/4, pi/4]
+	const float x2 = x * x;
+
+	const float s = x * (1.0f - x2 / 6.0f * (1.0f - x2 / 20.0f * (1.0f - x2 / 42.0f)));
+	const float c = 1.0f - x2 / 2.0f * (1.0f - x2 / 12.0f * (1.0f - x2 / 30.0f * (1.0f - x2 / 56.0f)));
+
+	// rotate back by the quarter turns taken out
+	switch (quarter & 3)
+	{
+	case 0:  _cos = c;  _sin = s;  break;
+	case 1:  _cos = -s; _sin = c;  break;
+	case 2:  _cos = -c; _sin = -s; break;
+	default: _cos = s;  _sin = -c; break;
+	}
+}
+
+#endif
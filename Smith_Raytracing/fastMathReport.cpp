@@ -0,0 +1,160 @@
+#include "fastMathReport.h"
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+	/**
+	 * \brief Distance between two floats in units in the last place (representable floats between them)
+	 */
+	int64_t UlpDistance(float _a, float _b) {
+		int32_t ia, ib;
+		std::memcpy(&ia, &_a, sizeof(ia));
+		std::memcpy(&ib, &_b, sizeof(ib));
+		// map the sign-magnitude layout onto a monotonic integer line
+		const int64_t la = ia < 0 ? static_cast<int64_t>(INT32_MIN) - ia : ia;
+		const int64_t lb = ib < 0 ? static_cast<int64_t>(INT32_MIN) - ib : ib;
+		return la > lb ? la - lb : lb - la;
+	}
+
+	struct ErrorStats
+	{
+		double MaxRelative_ = 0.0;
+		double MaxAbsolute_ = 0.0;
+		int64_t MaxUlp_ = 0;
+
+		void Add(float _approx, double _exact) {
+			const double absolute = std::fabs(_approx - _exact);
+			MaxAbsolute_ = std::fmax(MaxAbsolute_, absolute);
+			// near a zero crossing relative/ULP error is meaningless (any absolute error is "100%"), only count absolute there
+			if (std::fabs(_exact) < 1e-3)
+				return;
+			MaxRelative_ = std::fmax(MaxRelative_, absolute / std::fabs(_exact));
+			const int64_t ulp = UlpDistance(_approx, static_cast<float>(_exact));
+			MaxUlp_ = ulp > MaxUlp_ ? ulp : MaxUlp_;
+		}
+		void Print(std::ostream& _out, const char* _name) const {
+			_out << "  " << _name << ": max rel " << MaxRelative_ << ", max abs " << MaxAbsolute_ << ", max ulp " << MaxUlp_ << '\n';
+		}
+	};
+
+	double Rmse(const std::vector<int>& _a, const std::vector<int>& _b) {
+		double squaredError = 0.0;
+		for (size_t i = 0; i < _a.size(); ++i)
+			squaredError += static_cast<double>(_a[i] - _b[i]) * (_a[i] - _b[i]);
+		return std::sqrt(squaredError / static_cast<double>(_a.size()));
+	}
+
+	void PrintDifference(std::ostream& _out, const char* _name, const std::vector<int>& _a, const std::vector<int>& _b) {
+		int maxError = 0;
+		for (size_t i = 0; i < _a.size(); ++i)
+			maxError = std::max(maxError, std::abs(_a[i] - _b[i]));
+		const double rmse = Rmse(_a, _b);
+		_out << _name << ": RMSE " << rmse << " (of 255), max channel error " << maxError << ", PSNR "
+			<< (rmse > 0.0 ? 20.0 * std::log10(255.0 / rmse) : infinity) << " dB\n";
+	}
+
+	bool ReadPpm(const std::string& _path, int& _width, int& _height, std::vector<int>& _values) {
+		std::ifstream in(_path);
+		std::string magic;
+		int maxValue;
+		if (!(in >> magic >> _width >> _height >> maxValue) || magic != "P3")
+			return false;
+		_values.resize(static_cast<size_t>(_width) * _height * 3);
+		for (auto& v : _values)
+		{
+			if (!(in >> v))
+				return false;
+		}
+		return true;
+	}
+}
+
+void FastMath_ErrorReport(std::ostream& _out)
+{
+	constexpr int samples = 1 << 20;
+
+	_out << "Fast-math approximations vs precise (" << samples << " samples each):\n";
+
+	ErrorStats rsqrt;
+	for (int i = 0; i < samples; ++i)
+	{
+		const float x = static_cast<float>(std::pow(10.0, -6.0 + 12.0 * i / samples)); // 1e-6 .. 1e6, log spaced
+		rsqrt.Add(FastRsqrt(x), 1.0 / std::sqrt(static_cast<double>(x)));
+	}
+	rsqrt.Print(_out, "FastRsqrt (UnitVector)");
+
+	ErrorStats pow5;
+	for (int i = 0; i < samples; ++i)
+	{
+		const float x = static_cast<float>(i) / samples;
+		pow5.Add(Pow5(x), std::pow(static_cast<double>(x), 5.0));
+	}
+	pow5.Print(_out, "Pow5 (Dielectric::Reflectance)");
+
+	ErrorStats cosine, sine;
+	for (int i = 0; i < samples; ++i)
+	{
+		const float t = static_cast<float>(i) / samples;
+		float c, s;
+		FastSinCosTurns(t, c, s);
+		cosine.Add(c, std::cos(2.0 * pi * t));
+		sine.Add(s, std::sin(2.0 * pi * t));
+	}
+	cosine.Print(_out, "FastSinCosTurns cos");
+	sine.Print(_out, "FastSinCosTurns sin");
+
+	// Samplers: moments that are known exactly for the uniform distributions
+	double unitLengthError = 0.0, sphereR3 = 0.0, diskR2 = 0.0;
+	for (int i = 0; i < samples; ++i)
+	{
+		unitLengthError = std::fmax(unitLengthError, std::fabs(RandomUnitVector().Length() - 1.0));
+		const double rs = RandomInUnitSphere().Length();
+		sphereR3 += rs * rs * rs;
+		diskR2 += RandomInUnitDisk().LengthSquared();
+	}
+#ifdef RT_FAST_MATH
+	_out << "Samplers (this build: closed-form, RT_FAST_MATH):\n";
+#else
+	_out << "Samplers (this build: rejection, precise):\n";
+#endif
+	_out << "  RandomUnitVector max | |v| - 1 |: " << unitLengthError << '\n'
+		<< "  RandomInUnitSphere mean r^3: " << sphereR3 / samples << " (uniform: 0.5)\n"
+		<< "  RandomInUnitDisk mean r^2: " << diskR2 / samples << " (uniform: 0.5)\n";
+}
+
+bool CompareImages(const std::string& _pathA, const std::string& _pathB, const std::string& _pathNoise, std::ostream& _out)
+{
+	int widthA, heightA, widthB, heightB, widthNoise = 0, heightNoise = 0;
+	std::vector<int> a, b, noise;
+	if (!ReadPpm(_pathA, widthA, heightA, a) || !ReadPpm(_pathB, widthB, heightB, b)
+		|| (!_pathNoise.empty() && !ReadPpm(_pathNoise, widthNoise, heightNoise, noise)))
+	{
+		_out << "Couldn't read the images as plain PPM\n";
+		return false;
+	}
+	if (widthA != widthB || heightA != heightB || (!_pathNoise.empty() && (widthNoise != widthA || heightNoise != heightA)))
+	{
+		_out << "Image sizes differ\n";
+		return false;
+	}
+
+	const double rmseAB = Rmse(a, b);
+	PrintDifference(_out, "A vs B", a, b);
+	if (_pathNoise.empty())
+		return true;
+
+	// independent noise adds in quadrature: what A vs B/C has beyond B vs C is A's own error (bias), give or take noise
+	const double rmseAC = Rmse(a, noise), rmseBC = Rmse(b, noise);
+	PrintDifference(_out, "A vs C", a, noise);
+	PrintDifference(_out, "B vs C (noise floor)", b, noise);
+	const double excess = 0.5 * (rmseAB * rmseAB + rmseAC * rmseAC) - rmseBC * rmseBC;
+	_out << "A's RMSE above the noise floor: " << std::sqrt(std::fmax(excess, 0.0)) << " (of 255)"
+		<< (excess <= 0.0 ? ", none: A differs from B no more than B's own noise\n" : "\n");
+	return true;
+}
@@ -0,0 +1,23 @@
+#ifndef FAST_MATH_REPORT_H
+#define FAST_MATH_REPORT_H
+
+#include <iostream>
+#include <string>
+
+/**
+ * \brief Sweep every fast-math approximation against its precise counterpart and print the max relative and ULP
+ *	error of each, plus sanity statistics for the samplers compiled into this build
+ */
+void FastMath_ErrorReport(std::ostream& _out);
+
+/**
+ * \brief Print the RMSE and PSNR between two plain (P3) PPM images of the same size,
+ *	e.g. the same scene rendered with and without RT_FAST_MATH.
+ *	Two path traced images differ by their sampling noise even when nothing else changed, so give _pathNoise, _pathB
+ *	rendered again with another --seed, to also print that noise floor and how much of A's error is left above it
+ * \param _pathNoise optional, empty to only compare A and B
+ * \return FALSE if any image can't be read or their sizes differ
+ */
+bool CompareImages(const std::string& _pathA, const std::string& _pathB, const std::string& _pathNoise, std::ostream& _out);
+
+#endif
@@ -1,8 +1,11 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include "aabb.h"
 #include "ray.h"
 
+#include <cstdint>
+
 struct Material;
 
 struct HitInfo
@@ -35,6 +38,24 @@ struct Hittable
 	 * \return Bool has been hit?
 	 */
 	virtual bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _rec) const = 0;
+	/**
+	 * \brief Get a box that fully encloses this object
+	 * \param _outBox the bounding box
+	 * \return FALSE if the object has no finite bounds (e.g. an empty list)
+	 */
+	virtual bool BoundingBox(Aabb& _outBox) const = 0;
+	/**
+	 * \brief Copy this object's read-only data on the calling thread, so on first-touch systems the copy lives on
+	 *	that thread's NUMA node. Render() gives the threads of each node their own replica
+	 * \return nullptr if the object doesn't support it, callers then share this one
+	 */
+	virtual shared_ptr<Hittable> Replicate() const { return nullptr; }
+	/**
+	 * \brief Which block of this object's data a ray is likely to need first, for objects paged in from disk.
+	 *	Render() can sort queued rays by it (RenderOptions::SortRaysByBlock_) so rays that touch the same pages run together
+	 * \return 0 unless the object is split into blocks
+	 */
+	virtual uint32_t BlockKey(const Ray& _r) const { (void)_r; return 0; }
 };
 
 #endif
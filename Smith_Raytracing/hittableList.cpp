@@ -17,4 +17,20 @@ bool HittableList::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _rec) c
 	}
 
 	return hitAnything;
+}
+
+bool HittableList::BoundingBox(Aabb& _outBox) const
+{
+	if (objects.empty())
+		return false;
+
+	Aabb objectBox;
+	_outBox = Aabb();
+	for (const auto& object : objects)
+	{
+		if (!object->BoundingBox(objectBox))
+			return false;
+		_outBox.Extend(objectBox);
+	}
+	return true;
 }
\ No newline at end of file
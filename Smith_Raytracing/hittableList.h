@@ -22,6 +22,7 @@ struct HittableList : public Hittable
 	void Clear() { objects.clear(); }
 	void Add(const shared_ptr<Hittable>& _object) { objects.push_back(_object); }
 	virtual bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _rec) const override;
+	virtual bool BoundingBox(Aabb& _outBox) const override;
 };
 
 #endif
@@ -0,0 +1,608 @@
+#include "linearBvh.h"
+
+#include "parallel.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	constexpr size_t MinPerThread = 4096;	// below this many items per thread, spawning threads costs more than it saves
+
+	int CountLeadingZeros(uint64_t _x) {
+		if (_x == 0)
+			return 64;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long index;
+		_BitScanReverse64(&index, _x);
+		return 63 - static_cast<int>(index);
+#elif defined(_MSC_VER)
+		// 32-bit targets only have the 32-bit scan: look at the high half, then the low half
+		unsigned long index;
+		if (_BitScanReverse(&index, static_cast<unsigned long>(_x >> 32)))
+			return 31 - static_cast<int>(index);
+		_BitScanReverse(&index, static_cast<unsigned long>(_x));
+		return 63 - static_cast<int>(index);
+#else
+		return __builtin_clzll(_x);
+#endif
+	}
+
+	/**
+	 * \brief Spread the low 21 bits of _v out so there are two zero bits between each of them
+	 */
+	uint64_t ExpandBits(uint64_t _v) {
+		_v &= 0x1fffff;
+		_v = (_v | _v << 32) & 0x1f00000000ffffull;
+		_v = (_v | _v << 16) & 0x1f0000ff0000ffull;
+		_v = (_v | _v << 8) & 0x100f00f00f00f00full;
+		_v = (_v | _v << 4) & 0x10c30c30c30c30c3ull;
+		_v = (_v | _v << 2) & 0x1249249249249249ull;
+		return _v;
+	}
+
+	/**
+	 * \brief 63-bit Morton code of a point given in [0, 1]^3
+	 */
+	uint64_t MortonCode(const Vec3& _unit) {
+		constexpr float scale = (1 << 21) - 1;
+		const auto x = static_cast<uint64_t>(Clamp(_unit.X(), 0.0f, 1.0f) * scale);
+		const auto y = static_cast<uint64_t>(Clamp(_unit.Y(), 0.0f, 1.0f) * scale);
+		const auto z = static_cast<uint64_t>(Clamp(_unit.Z(), 0.0f, 1.0f) * scale);
+		return ExpandBits(x) << 2 | ExpandBits(y) << 1 | ExpandBits(z);
+	}
+
+	/**
+	 * \brief LSD radix sort of (code, index) pairs, 8 bits per pass.
+	 *	Each thread histograms its own chunk, the histograms are prefix-summed bucket-major, then every thread
+	 *	scatters its chunk into its own slots, so no two threads ever write the same element.
+	 */
+	void RadixSort(std::vector<uint64_t>& _codes, std::vector<uint32_t>& _indices) {
+		const size_t n = _codes.size();
+		std::vector<uint64_t> codesTmp(n);
+		std::vector<uint32_t> indicesTmp(n);
+		const unsigned maxChunks = ThreadCount();
+		std::vector<size_t> histograms(static_cast<size_t>(maxChunks) * 256);
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			std::fill(histograms.begin(), histograms.end(), 0);
+			const unsigned chunks = ParallelChunks(n, MinPerThread, [&](unsigned _chunk, size_t _begin, size_t _end) {
+				size_t* histogram = &histograms[_chunk * 256];
+				for (size_t i = _begin; i < _end; ++i)
+					++histogram[(_codes[i] >> shift) & 0xff];
+			});
+
+			// every key has the same digit? this pass wouldn't move anything
+			bool skipPass = false;
+			for (int digit = 0; digit < 256 && !skipPass; ++digit)
+			{
+				size_t total = 0;
+				for (unsigned c = 0; c < chunks; ++c)
+					total += histograms[c * 256 + digit];
+				skipPass = total == n;
+			}
+			if (skipPass)
+				continue;
+
+			// exclusive prefix sum: digit-major, then chunk, keeps the sort stable
+			size_t offset = 0;
+			for (int digit = 0; digit < 256; ++digit)
+			{
+				for (unsigned c = 0; c < chunks; ++c)
+				{
+					const size_t count = histograms[c * 256 + digit];
+					histograms[c * 256 + digit] = offset;
+					offset += count;
+				}
+			}
+
+			ParallelChunks(n, MinPerThread, [&](unsigned _chunk, size_t _begin, size_t _end) {
+				size_t* next = &histograms[_chunk * 256];
+				for (size_t i = _begin; i < _end; ++i)
+				{
+					const size_t dst = next[(_codes[i] >> shift) & 0xff]++;
+					codesTmp[dst] = _codes[i];
+					indicesTmp[dst] = _indices[i];
+				}
+			});
+			_codes.swap(codesTmp);
+			_indices.swap(indicesTmp);
+		}
+	}
+
+	float SurfaceArea(const Aabb& _box) {
+		const Vec3 e = _box.Max_ - _box.Min_;
+		return 2.0f * (e.X() * e.Y() + e.Y() * e.Z() + e.Z() * e.X());
+	}
+
+	int PopCount(unsigned _x) {
+		int count = 0;
+		for (; _x != 0; _x &= _x - 1)
+			++count;
+		return count;
+	}
+
+	int LowestBit(unsigned _x) {
+		int bit = 0;
+		while (!(_x & (1u << bit)))
+			++bit;
+		return bit;
+	}
+
+	/**
+	 * \brief Treelet restructuring (Karras & Aila 2013, "Fast Parallel Construction of High-Quality BVHs").
+	 *	Grows a treelet under _root to 7 leaves by repeatedly opening its largest internal leaf, finds the
+	 *	topology over those leaves with the lowest summed internal node area by dynamic programming over
+	 *	leaf subsets, and rewires the treelet's internal nodes into that shape if it beats the current one
+	 *	without making the subtree taller than _maxHeight.
+	 *	Everything under _root must already be fitted, with its height in _heights; nothing above it is touched.
+	 */
+	void RestructureTreelet(std::vector<LbvhNode>& _nodes, std::vector<uint8_t>& _heights, uint32_t _root, uint32_t _leafOffset, int _maxHeight) {
+		constexpr int MaxLeaves = 7;
+		uint32_t leaves[MaxLeaves] = { _nodes[_root].Left_, _nodes[_root].Right_ };
+		uint32_t internals[MaxLeaves - 1];	// the treelet's internal nodes besides the root, reused when rewiring
+		int leafCount = 2;
+		int internalCount = 0;
+		float oldCost = SurfaceArea(_nodes[_root].Bounds_);
+
+		while (leafCount < MaxLeaves)
+		{
+			int largest = -1;
+			for (int i = 0; i < leafCount; ++i)
+			{
+				if (leaves[i] < _leafOffset && (largest < 0 || SurfaceArea(_nodes[leaves[i]].Bounds_) > SurfaceArea(_nodes[leaves[largest]].Bounds_)))
+					largest = i;
+			}
+			if (largest < 0)
+				break;
+			const uint32_t opened = leaves[largest];
+			internals[internalCount++] = opened;
+			oldCost += SurfaceArea(_nodes[opened].Bounds_);
+			leaves[largest] = _nodes[opened].Left_;
+			leaves[leafCount++] = _nodes[opened].Right_;
+		}
+		if (leafCount < 3)
+			return;
+
+		// best cost of a subtree over each subset of the leaves = its area + best costs of its two halves
+		const unsigned full = (1u << leafCount) - 1;
+		Aabb boxes[1 << MaxLeaves];
+		float cost[1 << MaxLeaves];
+		unsigned bestSplit[1 << MaxLeaves];
+		int height[1 << MaxLeaves];	// of the best subtree over each subset
+		for (unsigned set = 1; set <= full; ++set)
+		{
+			const int low = LowestBit(set);
+			if (set == (1u << low))
+			{
+				boxes[set] = _nodes[leaves[low]].Bounds_;
+				cost[set] = 0.0f;
+				height[set] = _heights[leaves[low]];
+				continue;
+			}
+			boxes[set] = boxes[set & (set - 1)];
+			boxes[set].Extend(boxes[1u << low]);
+
+			// every split of the set into two non-empty halves, each counted once (the half with the lowest leaf)
+			float best = static_cast<float>(infinity);
+			for (unsigned part = (set - 1) & set; part != 0; part = (part - 1) & set)
+			{
+				if (!(part & (1u << low)))
+					continue;
+				const float c = cost[part] + cost[set ^ part];
+				if (c < best)
+				{
+					best = c;
+					bestSplit[set] = part;
+				}
+			}
+			cost[set] = SurfaceArea(boxes[set]) + best;
+			height[set] = 1 + std::max(height[bestSplit[set]], height[set ^ bestSplit[set]]);
+		}
+		if (cost[full] >= oldCost * 0.9999f || height[full] > _maxHeight)
+			return;
+
+		// rewire: the root keeps its index, the opened nodes are handed out again top-down
+		struct Pending { unsigned Set_; uint32_t Node_; };
+		Pending stack[MaxLeaves];
+		int stackSize = 0;
+		int nextInternal = 0;
+		stack[stackSize++] = { full, _root };
+		while (stackSize > 0)
+		{
+			const Pending pending = stack[--stackSize];
+			const unsigned halves[2] = { bestSplit[pending.Set_], pending.Set_ ^ bestSplit[pending.Set_] };
+			uint32_t children[2];
+			for (int h = 0; h < 2; ++h)
+			{
+				if (PopCount(halves[h]) == 1)
+					children[h] = leaves[LowestBit(halves[h])];
+				else
+				{
+					children[h] = internals[nextInternal++];
+					stack[stackSize++] = { halves[h], children[h] };
+				}
+			}
+			_nodes[pending.Node_].Left_ = children[0];
+			_nodes[pending.Node_].Right_ = children[1];
+			_nodes[pending.Node_].Bounds_ = boxes[pending.Set_];
+			_heights[pending.Node_] = static_cast<uint8_t>(height[pending.Set_]);
+		}
+	}
+
+	/**
+	 * \brief Recursive part of BuildBinnedSah(): build the subtree over _order[_begin, _end)
+	 * \return index of its root node
+	 */
+	uint32_t BuildSahNode(const std::vector<Aabb>& _boxes, const std::vector<point3>& _centroids, std::vector<uint32_t>& _order,
+		std::vector<LbvhNode>& _nodes, uint32_t& _nextInternal, size_t _begin, size_t _end, int _depth) {
+		const auto leafOffset = static_cast<uint32_t>(_boxes.size() - 1);
+		if (_end - _begin == 1)
+		{
+			const auto leaf = static_cast<uint32_t>(leafOffset + _begin);
+			_nodes[leaf].Bounds_ = _boxes[_order[_begin]];
+			return leaf;
+		}
+
+		const uint32_t index = _nextInternal++;
+		Aabb centroidBounds;
+		for (size_t i = _begin; i < _end; ++i)
+			centroidBounds.Extend(_centroids[_order[i]]);
+
+		// SAH over 16 bins per axis: cost of a split = area(left) * count(left) + area(right) * count(right)
+		constexpr int Bins = 16;
+		int bestAxis = -1, bestBin = 0;
+		float bestCost = static_cast<float>(infinity);
+		for (int axis = 0; axis < 3 && _depth < 64; ++axis) // past depth 64 fall back to median splits so traversal stacks stay bounded
+		{
+			const float lo = centroidBounds.Min_[axis], extent = centroidBounds.Max_[axis] - lo;
+			if (extent <= 0.0f)
+				continue;
+			Aabb binBoxes[Bins];
+			size_t binCounts[Bins] = {};
+			for (size_t i = _begin; i < _end; ++i)
+			{
+				const int bin = std::min(Bins - 1, static_cast<int>(Bins * (_centroids[_order[i]][axis] - lo) / extent));
+				binBoxes[bin].Extend(_boxes[_order[i]]);
+				++binCounts[bin];
+			}
+
+			// sweep from the right to get the right side of every split, then from the left to score them
+			float rightAreas[Bins];
+			size_t rightCounts[Bins];
+			Aabb box;
+			size_t count = 0;
+			for (int b = Bins - 1; b > 0; --b)
+			{
+				box.Extend(binBoxes[b]);
+				count += binCounts[b];
+				rightAreas[b] = count > 0 ? SurfaceArea(box) : 0.0f;
+				rightCounts[b] = count;
+			}
+			box = Aabb();
+			count = 0;
+			for (int b = 1; b < Bins; ++b)
+			{
+				box.Extend(binBoxes[b - 1]);
+				count += binCounts[b - 1];
+				if (count == 0 || rightCounts[b] == 0)
+					continue;
+				const float c = SurfaceArea(box) * count + rightAreas[b] * rightCounts[b];
+				if (c < bestCost)
+				{
+					bestCost = c;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		size_t mid = _begin + (_end - _begin) / 2;
+		if (bestAxis >= 0)
+		{
+			const float lo = centroidBounds.Min_[bestAxis], extent = centroidBounds.Max_[bestAxis] - lo;
+			mid = std::partition(_order.begin() + _begin, _order.begin() + _end, [&](uint32_t _i) {
+				return std::min(Bins - 1, static_cast<int>(Bins * (_centroids[_i][bestAxis] - lo) / extent)) < bestBin;
+			}) - _order.begin();
+		}
+		else
+		{
+			const int axis = centroidBounds.LongestAxis();
+			std::nth_element(_order.begin() + _begin, _order.begin() + mid, _order.begin() + _end,
+				[&](uint32_t _a, uint32_t _b) { return _centroids[_a][axis] < _centroids[_b][axis]; });
+		}
+
+		const uint32_t left = BuildSahNode(_boxes, _centroids, _order, _nodes, _nextInternal, _begin, mid, _depth + 1);
+		const uint32_t right = BuildSahNode(_boxes, _centroids, _order, _nodes, _nextInternal, mid, _end, _depth + 1);
+		_nodes[index].Left_ = left;
+		_nodes[index].Right_ = right;
+		_nodes[index].Bounds_ = _nodes[left].Bounds_;
+		_nodes[index].Bounds_.Extend(_nodes[right].Bounds_);
+		return index;
+	}
+}
+
+void BuildLbvh(const std::vector<Aabb>& _boxes, std::vector<uint32_t>& _order, std::vector<LbvhNode>& _nodes, bool _refineTreelets)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const size_t n = _boxes.size();
+
+	// 1. Morton codes, normalized to the centroid bounds
+	Aabb centroidBounds;
+	for (const auto& box : _boxes)
+		centroidBounds.Extend(box.Centroid());
+	Vec3 extent = centroidBounds.Max_ - centroidBounds.Min_;
+	for (int a = 0; a < 3; ++a)
+		extent[a] = extent[a] > 0.0f ? extent[a] : 1.0f; // flat along this axis, any scale works
+
+	std::vector<uint64_t> codes(n);
+	_order.resize(n);
+	ParallelFor(n, MinPerThread, [&](size_t _i) {
+		const Vec3 offset = _boxes[_i].Centroid() - centroidBounds.Min_;
+		codes[_i] = MortonCode(Vec3(offset.X() / extent.X(), offset.Y() / extent.Y(), offset.Z() / extent.Z()));
+		_order[_i] = static_cast<uint32_t>(_i);
+	});
+
+	// 2. Sort
+	RadixSort(codes, _order);
+
+	_nodes.resize(2 * n - 1);
+	const auto leafOffset = static_cast<uint32_t>(n - 1);
+	ParallelFor(n, MinPerThread, [&](size_t _i) {
+		_nodes[leafOffset + _i].Bounds_ = _boxes[_order[_i]];
+	});
+
+	// 3. Internal nodes (Karras 2012, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees").
+	// Node i covers a range of sorted keys with i at one end; its split is where the highest differing bit flips.
+	std::vector<uint32_t> parents(2 * n - 1, 0);
+	const auto longestCommonPrefix = [&](int64_t _i, int64_t _j) -> int {
+		if (_j < 0 || _j >= static_cast<int64_t>(n))
+			return -1;
+		if (codes[_i] == codes[_j]) // duplicate codes: fall back to the index to keep keys unique
+			return 64 + CountLeadingZeros(static_cast<uint64_t>(_i ^ _j)) - 32;
+		return CountLeadingZeros(codes[_i] ^ codes[_j]);
+	};
+
+	ParallelFor(n - 1, MinPerThread, [&](size_t _node) {
+		const auto i = static_cast<int64_t>(_node);
+
+		// direction of the range, and a bound on its length
+		const int64_t d = longestCommonPrefix(i, i + 1) > longestCommonPrefix(i, i - 1) ? 1 : -1;
+		const int deltaMin = longestCommonPrefix(i, i - d);
+		int64_t lengthMax = 2;
+		while (longestCommonPrefix(i, i + lengthMax * d) > deltaMin)
+			lengthMax *= 2;
+
+		// binary search for the other end
+		int64_t length = 0;
+		for (int64_t t = lengthMax / 2; t >= 1; t /= 2)
+		{
+			if (longestCommonPrefix(i, i + (length + t) * d) > deltaMin)
+				length += t;
+		}
+		const int64_t j = i + length * d;
+
+		// binary search for the split
+		const int deltaNode = longestCommonPrefix(i, j);
+		int64_t split = 0;
+		int64_t t = length;
+		do
+		{
+			t = (t + 1) / 2;
+			if (longestCommonPrefix(i, i + (split + t) * d) > deltaNode)
+				split += t;
+		} while (t > 1);
+		const int64_t gamma = i + split * d + std::min<int64_t>(d, 0);
+
+		LbvhNode& node = _nodes[_node];
+		node.Left_ = static_cast<uint32_t>(std::min(i, j) == gamma ? leafOffset + gamma : gamma);
+		node.Right_ = static_cast<uint32_t>(std::max(i, j) == gamma + 1 ? leafOffset + gamma + 1 : gamma + 1);
+		parents[node.Left_] = static_cast<uint32_t>(_node);
+		parents[node.Right_] = static_cast<uint32_t>(_node);
+	});
+
+	// depth of each internal node as built, so restructuring knows how tall each subtree may grow: a subtree kept
+	// within MaxLbvhDepth - its depth stays within the limit whatever happens above it, as its ancestors check the same
+	std::vector<uint8_t> depths, heights;
+	if (_refineTreelets && n > 1)
+	{
+		depths.resize(n - 1, 0);
+		heights.resize(2 * n - 1, 0);
+		std::vector<uint32_t> pending(1, 0);
+		while (!pending.empty())
+		{
+			const uint32_t node = pending.back();
+			pending.pop_back();
+			for (const uint32_t child : { _nodes[node].Left_, _nodes[node].Right_ })
+			{
+				if (child >= leafOffset)
+					continue;
+				depths[child] = static_cast<uint8_t>(depths[node] + 1);
+				pending.push_back(child);
+			}
+		}
+	}
+
+	// 4. Fit boxes bottom-up. Every leaf walks towards the root; the first to reach a node stops there,
+	// the second knows both children are done and fits the node.
+	std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[n - 1]);
+	for (size_t i = 0; i + 1 < n; ++i)
+		visits[i].store(0, std::memory_order_relaxed);
+
+	ParallelFor(n, MinPerThread, [&](size_t _leaf) {
+		uint32_t node = leafOffset + static_cast<uint32_t>(_leaf);
+		while (node != 0)
+		{
+			node = parents[node];
+			if (visits[node].fetch_add(1, std::memory_order_acq_rel) == 0)
+				return;
+			Aabb box = _nodes[_nodes[node].Left_].Bounds_;
+			box.Extend(_nodes[_nodes[node].Right_].Bounds_);
+			_nodes[node].Bounds_ = box;
+			if (_refineTreelets)
+			{
+				heights[node] = static_cast<uint8_t>(1 + std::max(heights[_nodes[node].Left_], heights[_nodes[node].Right_]));
+				RestructureTreelet(_nodes, heights, node, leafOffset, MaxLbvhDepth - depths[node]);
+			}
+		}
+	});
+
+	const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (LogBvhBuilds())
+		std::cerr << "BuildLbvh" << (_refineTreelets ? " (treelets)" : "") << ": " << n << " primitives in " << ms
+			<< " ms on up to " << ThreadCount() << " threads, SAH cost " << LbvhSahCost(_nodes) << '\n';
+}
+
+void BuildBinnedSah(const std::vector<Aabb>& _boxes, std::vector<uint32_t>& _order, std::vector<LbvhNode>& _nodes)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const size_t n = _boxes.size();
+
+	std::vector<point3> centroids(n);
+	_order.resize(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		centroids[i] = _boxes[i].Centroid();
+		_order[i] = static_cast<uint32_t>(i);
+	}
+	_nodes.resize(2 * n - 1);
+	uint32_t nextInternal = 0;
+	BuildSahNode(_boxes, centroids, _order, _nodes, nextInternal, 0, n, 0);
+
+	const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (LogBvhBuilds())
+		std::cerr << "BuildBinnedSah: " << n << " primitives in " << ms << " ms, SAH cost " << LbvhSahCost(_nodes) << '\n';
+}
+
+void BuildBvh(BvhBuilder _builder, const std::vector<Aabb>& _boxes, std::vector<uint32_t>& _order, std::vector<LbvhNode>& _nodes)
+{
+	if (_builder == BvhBuilder::BinnedSah)
+		BuildBinnedSah(_boxes, _order, _nodes);
+	else
+		BuildLbvh(_boxes, _order, _nodes, _builder == BvhBuilder::LbvhTreelets);
+}
+
+float LbvhSahCost(const std::vector<LbvhNode>& _nodes)
+{
+	if (_nodes.empty())
+		return 0.0f;
+
+	// every node costs (its area / root area) * (1 traversal step or 1 intersection)
+	double cost = 0.0;
+	for (const LbvhNode& node : _nodes)
+		cost += SurfaceArea(node.Bounds_);
+	return static_cast<float>(cost / SurfaceArea(_nodes[0].Bounds_));
+}
+
+int LbvhDepth(const std::vector<LbvhNode>& _nodes)
+{
+	if (_nodes.size() < 2)
+		return 0;
+
+	const size_t leafOffset = _nodes.size() / 2;
+	std::vector<std::pair<uint32_t, int>> pending(1, std::make_pair(0u, 0));
+	int depth = 0;
+	while (!pending.empty())
+	{
+		const auto node = pending.back();
+		pending.pop_back();
+		if (node.first >= leafOffset)
+		{
+			depth = std::max(depth, node.second);
+			continue;
+		}
+		pending.emplace_back(_nodes[node.first].Left_, node.second + 1);
+		pending.emplace_back(_nodes[node.first].Right_, node.second + 1);
+	}
+	return depth;
+}
+
+LinearBvh::LinearBvh(std::vector<shared_ptr<Hittable>> _objects, BvhBuilder _builder)
+{
+	// Bounds of everything that has them
+	std::vector<Aabb> boxes(_objects.size());
+	std::vector<char> bounded(_objects.size());
+	ParallelFor(_objects.size(), MinPerThread, [&](size_t _i) {
+		bounded[_i] = _objects[_i]->BoundingBox(boxes[_i]) ? 1 : 0;
+	});
+
+	std::vector<shared_ptr<Hittable>> boundedObjects;
+	std::vector<Aabb> boundedBoxes;
+	boundedObjects.reserve(_objects.size());
+	boundedBoxes.reserve(_objects.size());
+	for (size_t i = 0; i < _objects.size(); ++i)
+	{
+		if (bounded[i])
+		{
+			boundedObjects.push_back(std::move(_objects[i]));
+			boundedBoxes.push_back(boxes[i]);
+		}
+		else
+			unbounded_.push_back(std::move(_objects[i]));
+	}
+
+	if (boundedObjects.empty())
+		return;
+
+	std::vector<uint32_t> order;
+	BuildBvh(_builder, boundedBoxes, order, nodes_);
+	objects_.resize(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		objects_[i] = std::move(boundedObjects[order[i]]);
+}
+
+bool LinearBvh::BoundingBox(Aabb& _outBox) const
+{
+	if (!unbounded_.empty() || nodes_.empty())
+		return false;
+	_outBox = nodes_[0].Bounds_;
+	return true;
+}
+
+shared_ptr<Hittable> LinearBvh::Replicate() const
+{
+	auto copy = make_shared<LinearBvh>(*this);
+	for (auto* objects : { &copy->objects_, &copy->unbounded_ })
+	{
+		for (auto& object : *objects)
+		{
+			if (auto replica = object->Replicate())
+				object = std::move(replica);
+		}
+	}
+	return copy;
+}
+
+bool LinearBvh::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const
+{
+	HitInfo tempInfo;
+	bool hitAnything = false;
+	auto closestSoFar = _tMax;
+
+	for (const auto& object : unbounded_)
+	{
+		if (object->Hit(_r, _tMin, closestSoFar, tempInfo))
+		{
+			hitAnything = true;
+			closestSoFar = tempInfo.T_;
+			_info = tempInfo;
+		}
+	}
+
+	const bool hitTree = TraverseLbvh(nodes_, _r, _tMin, closestSoFar, [&](uint32_t _leaf, float& _closest) {
+		if (!objects_[_leaf]->Hit(_r, _tMin, _closest, tempInfo))
+			return false;
+		_closest = tempInfo.T_;
+		_info = tempInfo;
+		return true;
+	});
+
+	return hitAnything || hitTree;
+}
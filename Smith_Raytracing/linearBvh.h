@@ -0,0 +1,174 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include "hittable.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Node of a tree built by BuildLbvh(). Children with index >= n - 1 are leaves; leaf i is sorted primitive i
+ */
+struct LbvhNode
+{
+	Aabb Bounds_;
+	uint32_t Left_;
+	uint32_t Right_;
+};
+
+/**
+ * \brief Deepest a tree from any builder gets, counting edges from the root to a leaf. An LBVH is at most 96 deep
+ *	(63 Morton bits + 32 index bits), binned SAH switches to median splits past depth 64, and treelet restructuring
+ *	skips any rewrite that would take a subtree past this limit
+ */
+constexpr int MaxLbvhDepth = 127;
+
+/**
+ * \brief Entries TraverseLbvh() needs on its stack: a depth-first walk keeps at most one pending sibling per level
+ */
+constexpr int LbvhStackSize = MaxLbvhDepth + 1;
+
+/**
+ * \brief Which algorithm builds a tree. All of them produce the same node layout, so any tree works with TraverseLbvh()
+ */
+enum class BvhBuilder
+{
+	Lbvh,			// Morton-code LBVH: fastest, parallel build
+	LbvhTreelets,	// LBVH, then every 7-leaf treelet reshaped to its optimal SAH topology (Karras & Aila 2013)
+	BinnedSah		// classic top-down binned SAH: slow serial build, reference for trace quality
+};
+
+/**
+ * \brief Whether builds report their time and SAH cost on stderr. Callers building many small trees turn it off
+ */
+inline bool& LogBvhBuilds() {
+	static bool log = true;
+	return log;
+}
+
+/**
+ * \brief Build a bounding volume hierarchy the LBVH way (Karras 2012), so construction is parallel and O(n):
+ *	1. 63-bit Morton codes of each box's centroid
+ *	2. parallel radix sort by code
+ *	3. every internal node found independently from the sorted codes
+ *	4. parallel bottom-up bounding box fitting, optionally reshaping treelets along the way
+ * \param _boxes bounds of each primitive, at least one
+ * \param _order out: the primitives in Morton (leaf) order, as indices into _boxes
+ * \param _nodes out: n - 1 internal nodes followed by n leaves. Root is node 0
+ * \param _refineTreelets optimize each node's 7-leaf treelet for SAH once its subtree is fitted
+ */
+void BuildLbvh(const std::vector<Aabb>& _boxes, std::vector<uint32_t>& _order, std::vector<LbvhNode>& _nodes, bool _refineTreelets = false);
+
+/**
+ * \brief Build the same layout as BuildLbvh() top-down, splitting each node at the best of 16 SAH bins per axis
+ */
+void BuildBinnedSah(const std::vector<Aabb>& _boxes, std::vector<uint32_t>& _order, std::vector<LbvhNode>& _nodes);
+
+/**
+ * \brief Build with the chosen algorithm, see BvhBuilder
+ */
+void BuildBvh(BvhBuilder _builder, const std::vector<Aabb>& _boxes, std::vector<uint32_t>& _order, std::vector<LbvhNode>& _nodes);
+
+/**
+ * \brief Surface area heuristic cost of a tree (traversal cost 1, intersection cost 1), a proxy for trace speed
+ */
+float LbvhSahCost(const std::vector<LbvhNode>& _nodes);
+
+/**
+ * \brief Edges from the root to the deepest leaf, at most MaxLbvhDepth for trees BuildBvh() made
+ */
+int LbvhDepth(const std::vector<LbvhNode>& _nodes);
+
+/**
+ * \brief Walk a tree built by BuildLbvh() (_nodeCount nodes at _nodes, which may live in a mapped file), calling
+ *	_hitLeaf(leafIndex, closestSoFar) for every leaf whose box the ray enters.
+ *	_hitLeaf returns TRUE on a hit and lowers closestSoFar to it, which prunes the rest of the walk.
+ *	The walk stops early on a tree no builder makes: a child index past the nodes, a tree deeper than MaxLbvhDepth,
+ *	or a node reached twice (a cycle). That sets *_malformed if given, for trees read from files, and asserts otherwise.
+ */
+template <typename HitLeaf>
+bool TraverseLbvh(const LbvhNode* _nodes, size_t _nodeCount, const Ray& _r, float _tMin, float& _closestSoFar, HitLeaf _hitLeaf,
+	bool* _malformed = nullptr) {
+	if (_nodeCount == 0)
+		return false;
+
+	const Vec3 invDir(1.0f / _r.Direction_.X(), 1.0f / _r.Direction_.Y(), 1.0f / _r.Direction_.Z());
+	const auto leafOffset = static_cast<uint32_t>(_nodeCount / 2);
+	bool hitAnything = false;
+
+	uint32_t stack[LbvhStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	size_t visits = 0;	// each node is reached at most once in a real tree
+	while (stackSize > 0)
+	{
+		const uint32_t index = stack[--stackSize];
+		const LbvhNode& node = _nodes[index];
+		if (!node.Bounds_.Hit(_r, invDir, _tMin, _closestSoFar))
+			continue;
+
+		if (index >= leafOffset)
+		{
+			if (_hitLeaf(index - leafOffset, _closestSoFar))
+				hitAnything = true;
+		}
+		else
+		{
+			if (stackSize + 2 > LbvhStackSize || ++visits > _nodeCount || node.Left_ >= _nodeCount || node.Right_ >= _nodeCount)
+			{
+				if (_malformed)
+					*_malformed = true;
+				else
+					assert(!"TraverseLbvh: not a tree BuildBvh() made");
+				return hitAnything; // give up rather than read or write out of bounds, or loop forever
+			}
+			stack[stackSize++] = node.Left_;
+			stack[stackSize++] = node.Right_;
+		}
+	}
+	return hitAnything;
+}
+
+/**
+ * \brief TraverseLbvh() over a tree held in a vector
+ */
+template <typename HitLeaf>
+bool TraverseLbvh(const std::vector<LbvhNode>& _nodes, const Ray& _r, float _tMin, float& _closestSoFar, HitLeaf _hitLeaf) {
+	return TraverseLbvh(_nodes.data(), _nodes.size(), _r, _tMin, _closestSoFar, _hitLeaf);
+}
+
+/**
+ * \brief BVH over a list of arbitrary Hittables
+ */
+class LinearBvh : public Hittable
+{
+public:
+	// - Constructors - //
+	/**
+	 * \param _objects primitives to build over. Objects without finite bounds are kept aside and always tested
+	 * \param _builder how to build the tree
+	 */
+	explicit LinearBvh(std::vector<shared_ptr<Hittable>> _objects, BvhBuilder _builder = BvhBuilder::LbvhTreelets);
+
+	// - Getters - //
+	size_t PrimitiveCount() const { return objects_.size(); }
+	float SahCost() const { return LbvhSahCost(nodes_); }
+	int Depth() const { return LbvhDepth(nodes_); }
+
+	// - Methods - //
+	bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const override;
+	bool BoundingBox(Aabb& _outBox) const override;
+	/**
+	 * \brief Copy the nodes and every primitive that can replicate itself. Primitives that can't, and materials, stay shared
+	 */
+	shared_ptr<Hittable> Replicate() const override;
+
+private:
+	std::vector<shared_ptr<Hittable>> objects_;	// in leaf order
+	std::vector<shared_ptr<Hittable>> unbounded_;
+	std::vector<LbvhNode> nodes_;
+};
+
+#endif
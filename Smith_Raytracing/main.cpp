@@ -2,11 +2,33 @@
 
 #include "camera.h"
 #include "color.h"
+#include "fastMathReport.h"
 #include "hittableList.h"
+#include "linearBvh.h"
+#include "mappedScene.h"
 #include "material.h"
+#include "objLoader.h"
+#include "parallel.h"
+#include "preview.h"
+#include "renderJob.h"
 #include "sphere.h"
+#include "sphereSet.h"
+#include "topology.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 /**
  * \brief Determine the color a ray returns after its bouncy journey
@@ -125,6 +147,130 @@ HittableList RandomScene() {
     return world;
 }
 
+/**
+ * \brief Material table of RandomSphereSet() and WriteRandomSphereFile(): 64 diffuse, 16 metal, glass, then the ground
+ */
+std::vector<shared_ptr<Material>> RandomSpherePalette() {
+    std::vector<shared_ptr<Material>> materials;
+    for (int i = 0; i < 64; ++i)
+        materials.push_back(make_shared<Lambertian>(colorRGB::Random() * colorRGB::Random()));
+    for (int i = 0; i < 16; ++i)
+        materials.push_back(make_shared<Metal>(colorRGB::Random(0.5f, 1.0f), RandomFloat(0, 0.5f)));
+    materials.push_back(make_shared<Dielectric>(1.5f));
+    materials.push_back(make_shared<Lambertian>(colorRGB(0.5f, 0.5f, 0.5f)));
+    return materials;
+}
+constexpr uint32_t PaletteGlass = 80;
+constexpr uint32_t PaletteGround = 81;
+
+/**
+ * \brief RandomScene()'s small spheres for the 1 unit grid cells [_aBegin, _aEnd) x [_bBegin, _bEnd), appended to _spheres
+ */
+void RandomSphereCells(int _aBegin, int _aEnd, int _bBegin, int _bEnd, std::vector<SphereSet::Entry>& _spheres) {
+    for (int a = _aBegin; a < _aEnd; a++) {
+        for (int b = _bBegin; b < _bEnd; b++) {
+            const auto chooseMat = RandomFloat();
+            const point3 center(static_cast<float>(a) + 0.9f * RandomFloat(), 0.2f, static_cast<float>(b) + 0.9f * RandomFloat());
+            if ((center - point3(4, 0.2f, 0)).Length() <= 0.9f)
+                continue;
+
+            uint32_t material;
+            if (chooseMat < 0.8f)
+                material = static_cast<uint32_t>(RandomFloat(0, 64));        // diffuse
+            else if (chooseMat < 0.95f)
+                material = 64 + static_cast<uint32_t>(RandomFloat(0, 16));   // metal
+            else
+                material = PaletteGlass;
+            _spheres.push_back({ center, 0.2f, material });
+        }
+    }
+}
+
+/**
+ * \return half the side, in grid cells, of the RandomScene()-like field holding about _count spheres
+ */
+int RandomSphereHalfExtent(size_t _count) {
+    return static_cast<int>(sqrt(static_cast<double>(_count)) / 2.0) + 1;
+}
+
+/**
+ * \brief RandomScene() scaled up to roughly _count small spheres, stored in one SphereSet.
+ *	Materials come from a fixed palette so the scene needs a handful of allocations no matter how big it gets
+ */
+shared_ptr<SphereSet> RandomSphereSet(size_t _count, BvhBuilder _builder = BvhBuilder::LbvhTreelets) {
+    std::vector<shared_ptr<Material>> materials = RandomSpherePalette();
+
+    // same 1 unit grid cells as RandomScene, just more of them
+    const int halfExtent = RandomSphereHalfExtent(_count);
+    std::vector<SphereSet::Entry> spheres;
+    spheres.reserve(4 * static_cast<size_t>(halfExtent) * halfExtent + 4);
+    spheres.push_back({ point3(0, -1000.0f - 2.0f * halfExtent, 0), 1000.0f + 2.0f * halfExtent, PaletteGround });
+    RandomSphereCells(-halfExtent, halfExtent, -halfExtent, halfExtent, spheres);
+
+    spheres.push_back({ point3(0, 1, 0), 1.0f, PaletteGlass });
+    spheres.push_back({ point3(-4, 1, 0), 1.0f, 0 });
+    spheres.push_back({ point3(4, 1, 0), 1.0f, 64 });
+
+    auto set = make_shared<SphereSet>(std::move(spheres), std::move(materials), _builder);
+    std::cerr << "RandomSphereSet: " << set->SphereCount() << " spheres, " << set->MemoryUsage() / (1024 * 1024) << " MiB\n";
+    return set;
+}
+
+/**
+ * \brief Write the RandomSphereSet() field with about _count spheres to a scene file without ever holding it in memory:
+ *	it is generated in square tiles of 256 x 256 cells, one chunk each, visited in Morton order so neighbouring tiles
+ *	end up close in the file. Each tile seeds the random generator from its index, so the file doesn't depend on
+ *	anything but _count. The big spheres and the ground get chunks of their own.
+ * \return FALSE if the file couldn't be written
+ */
+bool WriteRandomSphereFile(const std::string& _path, size_t _count, SceneNodeEncoding _encoding) {
+    constexpr int tileCells = 256;
+    const auto start = std::chrono::steady_clock::now();
+
+    SeedRandom(0);
+    SceneFileWriter writer(_path, RandomSpherePalette(), _encoding);
+    const int halfExtent = RandomSphereHalfExtent(_count);
+    writer.AddChunk({ { point3(0, -1000.0f - 2.0f * halfExtent, 0), 1000.0f + 2.0f * halfExtent, PaletteGround } });
+    writer.AddChunk({ { point3(0, 1, 0), 1.0f, PaletteGlass }, { point3(-4, 1, 0), 1.0f, 0 }, { point3(4, 1, 0), 1.0f, 64 } });
+
+    const int tilesPerSide = (2 * halfExtent + tileCells - 1) / tileCells;
+    uint32_t mortonSide = 1;
+    while (static_cast<int>(mortonSide) < tilesPerSide)
+        mortonSide *= 2;
+    const uint64_t tileCount = static_cast<uint64_t>(tilesPerSide) * tilesPerSide;
+    uint64_t tilesWritten = 0;
+    std::vector<SphereSet::Entry> spheres;
+    for (uint64_t code = 0; code < static_cast<uint64_t>(mortonSide) * mortonSide && writer.IsOpen(); ++code)
+    {
+        // even bits of the code are the tile's column, odd bits its row
+        int column = 0, row = 0;
+        for (int bit = 0; bit < 32; ++bit)
+        {
+            column |= static_cast<int>((code >> (2 * bit)) & 1) << bit;
+            row |= static_cast<int>((code >> (2 * bit + 1)) & 1) << bit;
+        }
+        if (column >= tilesPerSide || row >= tilesPerSide)
+            continue;
+
+        SeedRandom(static_cast<unsigned>(row * tilesPerSide + column + 1));
+        const int a = -halfExtent + column * tileCells, b = -halfExtent + row * tileCells;
+        spheres.clear();
+        RandomSphereCells(a, std::min(a + tileCells, halfExtent), b, std::min(b + tileCells, halfExtent), spheres);
+        writer.AddChunk(spheres);
+
+        if (++tilesWritten % 64 == 0 || tilesWritten == tileCount)
+            std::cerr << "\rWriting " << _path << ": " << tilesWritten << " / " << tileCount << " tiles, "
+                << writer.BytesWritten() / (1024 * 1024) << " MiB " << std::flush;
+    }
+    if (!writer.Finish())
+        return false;
+
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cerr << "\nWrote " << _path << " (" << (_encoding == SceneNodeEncoding::Quantized ? "quantized" : "full") << " nodes): "
+        << writer.BytesWritten() / (1024 * 1024) << " MiB in " << seconds.count() << " s\n";
+    return true;
+}
+
 void DepthOfField_TestScene() {
 
     // Image Properties
@@ -184,7 +330,729 @@ void DepthOfField_TestScene() {
 }
 
 
-int main() {
+/**
+ * \brief Minimum time between two rewrites of a live preview
+ */
+constexpr auto PreviewInterval = std::chrono::milliseconds(1000);
+
+/**
+ * \brief How Render() spreads work over the machine
+ */
+struct RenderOptions
+{
+    PreviewWriter* Preview_ = nullptr;  // optional live preview to publish finished rows to
+    unsigned Threads_ = 0;              // 0 = one per CPU
+    bool PinThreads_ = false;           // pin each thread to its own CPU, filling one NUMA node after another,
+                                        // and give each NUMA node its own replica of the world (Hittable::Replicate())
+    bool SortRaysByBlock_ = false;      // trace bands of rows breadth first in queues sorted by block, see TraceRowsSorted()
+    unsigned SampleSeed_ = 0;           // another value draws an independent set of samples of the same image
+};
+
+/**
+ * \brief Trace the scan lines [_first, _last) (counted from the top) breadth first into _rows: every sample's camera ray is
+ *	queued, then each bounce sorts the queue by Hittable::BlockKey() and traces it in that order, so rays needing the same
+ *	blocks of a scene paged in from disk run back to back instead of faulting the same pages in again and again.
+ *	Converges to the same image as Ray_Color_LambertHemisphere(); the random generator is seeded once per band,
+ *	from _seedOffset plus the band's first row, and the samples are added to what _rows already hold
+ */
+void TraceRowsSorted(const Hittable& _world, const Camera& _cam, int _imgWidth, int _imgHeight, int _samplesPerPixel, int _maxDepth,
+    int _first, int _last, unsigned _seedOffset, const std::unique_ptr<colorRGB[]>* _rows) {
+    struct QueuedRay
+    {
+        Ray Ray_;
+        colorRGB Throughput_;   // product of the attenuations so far
+        uint32_t Pixel_;        // (row - _first) * _imgWidth + column
+        uint32_t Key_;
+    };
+
+    SeedRandom(_seedOffset + static_cast<unsigned>(_imgHeight - _first));
+    std::vector<QueuedRay> queue;
+    queue.reserve(static_cast<size_t>(_last - _first) * _imgWidth * _samplesPerPixel);
+    for (int index = _first; index < _last; ++index)
+    {
+        const int row = _imgHeight - index; // rows are rendered top-down, v counts bottom-up
+        for (int col = 0; col < _imgWidth; ++col)
+        {
+            for (int s = 0; s < _samplesPerPixel; ++s)
+            {
+                const auto u = (col + RandomFloat()) / (_imgWidth - 1.0f);
+                const auto v = (row + RandomFloat()) / (_imgHeight - 1.0f);
+                queue.push_back({ _cam.GetRay(u, v), colorRGB(1, 1, 1), static_cast<uint32_t>((index - _first) * _imgWidth + col), 0 });
+            }
+        }
+    }
+
+    // rays still bouncing after _maxDepth hits gather no light, as in Ray_Color_LambertHemisphere()
+    for (int depth = _maxDepth; depth > 0 && !queue.empty(); --depth)
+    {
+        for (auto& queued : queue)
+            queued.Key_ = _world.BlockKey(queued.Ray_);
+        std::stable_sort(queue.begin(), queue.end(), [](const QueuedRay& _a, const QueuedRay& _b) { return _a.Key_ < _b.Key_; });
+
+        size_t bouncing = 0;
+        for (const auto& queued : queue)
+        {
+            HitInfo info;
+            if (_world.Hit(queued.Ray_, 0.001f, static_cast<float>(infinity), info))
+            {
+                Ray scattered;
+                colorRGB attenuation;
+                if (info.MaterialPtr_->Scatter(queued.Ray_, info, attenuation, scattered))
+                    queue[bouncing++] = { scattered, queued.Throughput_ * attenuation, queued.Pixel_, 0 };
+                continue;
+            }
+
+            const Vec3 unitDir = UnitVector(queued.Ray_.Direction());
+            const auto t = 0.5f * (unitDir.Y() + 1.0f);
+            _rows[queued.Pixel_ / _imgWidth][queued.Pixel_ % _imgWidth] += queued.Throughput_ * ((1.0f - t) * colorRGB(1.0f, 1.0f, 1.0f) + t * colorRGB(0.5f, 0.7f, 1.0f));
+        }
+        queue.resize(bouncing);
+    }
+}
+
+/**
+ * \brief Render the world through the camera and write it as a plain PPM.
+ *	Threads take scan lines one at a time. Each row's pixels are allocated by the thread that renders it so,
+ *	with pinned threads, the memory lands on that thread's NUMA node (first touch). Every row reseeds the random
+ *	generator from its index, so the image doesn't depend on the thread count or which thread got which row.
+ *	RenderOptions::SampleSeed_ moves every row's seed far from the ones other sample seeds use.
+ *	Workers always run on threads of their own, so pinning never changes the calling thread's affinity.
+ *	With a preview the frame is rendered progressively: a 1 sample pass over every row, then passes that each double
+ *	the samples so far, so a bad camera or material shows within seconds. Each pass reseeds the rows differently,
+ *	so the final image is a different (equally converged) sample of the picture than a single pass gives.
+ */
+void Render(const Hittable& _world, const Camera& _cam, int _imgWidth, int _imgHeight, int _samplesPerPixel, int _maxDepth,
+    std::ostream& _out, const RenderOptions& _options) {
+    const CpuTopology topology = DetectTopology();
+    const unsigned threadCount = _options.Threads_ > 0 ? _options.Threads_ : static_cast<unsigned>(topology.CpuCount());
+
+    // worker i runs on the i-th CPU counting node by node, so the first workers fill node 0 before spilling to node 1
+    std::vector<int> workerCpu, workerNode;
+    for (size_t node = 0; node < topology.NodeCpus_.size(); ++node)
+    {
+        for (int cpu : topology.NodeCpus_[node])
+        {
+            workerCpu.push_back(cpu);
+            workerNode.push_back(static_cast<int>(node));
+        }
+    }
+
+    // with pinned threads on several nodes, copy the world once per node from a thread pinned there (first touch),
+    // so BVH traversal reads local memory. Nodes without workers, or a world that can't replicate, share _world
+    std::vector<shared_ptr<Hittable>> replicas(topology.NodeCpus_.size());
+    std::vector<bool> nodeUsed(topology.NodeCpus_.size(), false);
+    for (unsigned w = 0; w < threadCount; ++w)
+        nodeUsed[workerNode[w % workerNode.size()]] = true;
+    if (_options.PinThreads_ && std::count(nodeUsed.begin(), nodeUsed.end(), true) > 1)
+    {
+        std::vector<std::thread> copiers;
+        for (size_t node = 0; node < replicas.size(); ++node)
+        {
+            if (!nodeUsed[node])
+                continue;
+            copiers.emplace_back([&, node] {
+                PinCurrentThread(topology.NodeCpus_[node][0]);
+                replicas[node] = _world.Replicate();
+            });
+        }
+        for (auto& c : copiers)
+            c.join();
+    }
+    const size_t replicaCount = std::count_if(replicas.begin(), replicas.end(), [](const shared_ptr<Hittable>& _r) { return _r != nullptr; });
+
+    // samples added by each pass: all of them at once, or 1, 1, 2, 4, ... for a progressive preview
+    std::vector<int> passSamples;
+    for (int done = 0; done < _samplesPerPixel; done += passSamples.back())
+        passSamples.push_back(_options.Preview_ ? std::min(std::max(done, 1), _samplesPerPixel - done) : _samplesPerPixel);
+
+    const int rowCount = _imgHeight + 1;
+    std::vector<std::unique_ptr<colorRGB[]>> rows(rowCount); // rows[i] is scan line i from the top
+    std::vector<long long> workerSamples(threadCount, 0);
+    std::atomic<int> nextRow(0);
+    std::mutex progressMutex;
+    int rowsRemaining = rowCount;
+    std::atomic<unsigned> pinnedCount(0);
+
+    // a row must finish a pass before the next one adds to it, so every worker waits at the end of each pass.
+    // The last one to arrive resets the row counters for the next pass
+    std::mutex passMutex;
+    std::condition_variable passChanged;
+    unsigned passArrivals = 0;
+    size_t passesDone = 0;
+    const auto finishPass = [&] {
+        std::unique_lock<std::mutex> lock(passMutex);
+        const size_t pass = passesDone;
+        if (++passArrivals < threadCount)
+        {
+            passChanged.wait(lock, [&] { return passesDone != pass; });
+            return;
+        }
+        passArrivals = 0;
+        nextRow = 0;
+        rowsRemaining = rowCount;
+        ++passesDone;
+        passChanged.notify_all();
+    };
+
+    // sorting needs many rays at once to find coherence, so sorted bands hold as many rows as fit raysPerBand
+    constexpr size_t raysPerBand = 1 << 18;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto worker = [&](unsigned _worker) {
+        const size_t slot = _worker % workerCpu.size();
+        if (_options.PinThreads_ && PinCurrentThread(workerCpu[slot]))
+            ++pinnedCount;
+        const Hittable& world = replicas[workerNode[slot]] ? *replicas[workerNode[slot]] : _world;
+
+        int samplesSoFar = 0;
+        for (size_t pass = 0; pass < passSamples.size(); ++pass)
+        {
+            const int samples = passSamples[pass];
+            samplesSoFar += samples;
+            // pass 0 seeds like a single pass render. Seeds are consecutive per row, so sample seeds are spread by a
+            // large odd constant to keep their ranges apart
+            const auto seedOffset = static_cast<unsigned>(pass * rowCount) + _options.SampleSeed_ * 0x9E3779B9u;
+            const int bandRows = _options.SortRaysByBlock_
+                ? std::max(1, static_cast<int>(raysPerBand / (static_cast<size_t>(_imgWidth) * samples))) : 1;
+
+            for (int first = nextRow.fetch_add(bandRows); first < rowCount; first = nextRow.fetch_add(bandRows))
+            {
+                const int last = std::min(first + bandRows, rowCount);
+                if (pass == 0)
+                {
+                    for (int index = first; index < last; ++index)
+                        rows[index].reset(new colorRGB[_imgWidth]);
+                }
+
+                if (_options.SortRaysByBlock_)
+                    TraceRowsSorted(world, _cam, _imgWidth, _imgHeight, samples, _maxDepth, first, last, seedOffset, &rows[first]);
+                else
+                {
+                    for (int index = first; index < last; ++index)
+                    {
+                        const int row = _imgHeight - index; // rows are rendered top-down, v counts bottom-up
+                        SeedRandom(seedOffset + static_cast<unsigned>(row));
+
+                        colorRGB* rowColors = rows[index].get();
+                        for (int col = 0; col < _imgWidth; ++col)
+                        {
+                            colorRGB pixelColor(0, 0, 0);
+                            for (int s = 0; s < samples; ++s)
+                            {
+                                const auto u = (col + RandomFloat()) / (_imgWidth - 1.0f);
+                                const auto v = (row + RandomFloat()) / (_imgHeight - 1.0f);
+                                Ray r = _cam.GetRay(u, v);
+                                pixelColor += Ray_Color_LambertHemisphere(r, world, _maxDepth);
+                            }
+                            rowColors[col] += pixelColor;
+                        }
+                    }
+                }
+
+                for (int index = first; index < last; ++index)
+                {
+                    workerSamples[_worker] += static_cast<long long>(_imgWidth) * samples;
+                    if (_options.Preview_)
+                        _options.Preview_->SubmitRow(index, rows[index].get(), samplesSoFar);
+
+                    // Progress indicator
+                    std::lock_guard<std::mutex> lock(progressMutex);
+                    std::cerr << '\r';
+                    if (passSamples.size() > 1)
+                        std::cerr << "Pass " << pass + 1 << '/' << passSamples.size() << " (" << samplesSoFar << " spp), ";
+                    std::cerr << "Scan lines remaining: " << --rowsRemaining << ' ' << std::flush;
+                }
+            }
+            finishPass();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threadCount; ++w)
+        workers.emplace_back(worker, w);
+    for (auto& w : workers)
+        w.join();
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    _out << "P3\n" << _imgWidth << ' ' << _imgHeight << "\n255\n";
+    for (const auto& row : rows)
+    {
+        for (int col = 0; col < _imgWidth; ++col)
+            Write_Color(_out, row[col], _samplesPerPixel);
+    }
+
+    // Stats: throughput per NUMA node
+    std::cerr << "\nRendered on " << threadCount << " threads";
+    if (_options.PinThreads_)
+        std::cerr << " (" << pinnedCount << " pinned)";
+    std::cerr << " across " << topology.NodeCpus_.size() << " NUMA node(s)";
+    if (replicaCount > 0)
+        std::cerr << ", world replicated on " << replicaCount << " of them";
+    std::cerr << '\n';
+    for (size_t node = 0; node < topology.NodeCpus_.size(); ++node)
+    {
+        long long nodeSamples = 0;
+        unsigned nodeThreads = 0;
+        for (unsigned w = 0; w < threadCount; ++w)
+        {
+            if (workerNode[w % workerNode.size()] != static_cast<int>(node))
+                continue;
+            nodeSamples += workerSamples[w];
+            ++nodeThreads;
+        }
+        if (nodeThreads == 0)
+            continue;
+        std::cerr << "  node " << topology.NodeIds_[node] << ": " << nodeThreads << " threads, " << nodeSamples << " samples, "
+            << static_cast<double>(nodeSamples) / seconds.count() << " samples/sec\n";
+    }
+}
+
+/**
+ * \brief Build the scene a job refers to
+ * \return nullptr if it can't be built
+ */
+shared_ptr<Hittable> BuildScene(const std::string& _scene) {
+    // always seed: the job thread's generator holds whatever earlier jobs left in it, and scenes are cached by name
+    if (_scene == "random" || _scene.compare(0, 7, "random:") == 0)
+    {
+        SeedRandom(_scene.size() > 7 ? static_cast<unsigned>(strtoul(_scene.c_str() + 7, nullptr, 10)) : std::mt19937::default_seed);
+        return make_shared<LinearBvh>(RandomScene().objects);
+    }
+    if (_scene.compare(0, 8, "spheres:") == 0)
+    {
+        SeedRandom(std::mt19937::default_seed);
+        return RandomSphereSet(strtoul(_scene.c_str() + 8, nullptr, 10));
+    }
+    if (_scene.size() > 8 && _scene.compare(_scene.size() - 8, 8, ".rtscene") == 0)
+        return OpenSceneFile(_scene);
+    if (_scene.size() > 4 && _scene.compare(_scene.size() - 4, 4, ".obj") == 0)
+        return LoadObj(_scene, make_shared<Lambertian>(colorRGB(0.7f, 0.3f, 0.3f)));
+
+    std::cerr << "Unknown scene " << _scene << '\n';
+    return nullptr;
+}
+
+/**
+ * \brief Render jobs (see RenderJob) as their lines arrive on _jobList, until it ends.
+ *	A reader thread queues each job as soon as its line is read, so a pipe can keep this process alive and feed it
+ *	work; whenever a render finishes, the highest priority job already queued goes next.
+ *	Built scenes and their acceleration structures are kept, up to _maxCachedScenes of them, and reused by every job
+ *	that names them, so a camera or sample-count sweep only pays for scene setup the first time.
+ * \param _options how to render each job. SortRaysByBlock_ only applies to scene files (.rtscene)
+ * \param _previewPath if not empty, every job streams a progressive preview there while it renders, see PreviewWriter
+ * \param _maxCachedScenes how many built scenes to keep; past that the least recently used one is dropped
+ */
+int RenderJobs(std::istream& _jobList, const RenderOptions& _options, const std::string& _previewPath, size_t _maxCachedScenes) {
+    constexpr int maxDepth = 50;
+
+    struct QueuedJob
+    {
+        RenderJob Job_;
+        long long Sequence_;    // ties in priority go in arrival order
+        std::chrono::steady_clock::time_point Arrival_;
+    };
+    const auto runsLater = [](const QueuedJob& _a, const QueuedJob& _b) {
+        return _a.Job_.Priority_ != _b.Job_.Priority_ ? _a.Job_.Priority_ < _b.Job_.Priority_ : _a.Sequence_ > _b.Sequence_;
+    };
+    std::priority_queue<QueuedJob, std::vector<QueuedJob>, decltype(runsLater)> queue(runsLater);
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    bool listEnded = false;
+    int malformed = 0;
+
+    std::thread reader([&] {
+        std::string line, error;
+        RenderJob job;
+        for (long long lineNumber = 1; std::getline(_jobList, line); ++lineNumber)
+        {
+            const JobLine parsed = ParseRenderJob(line, job, error);
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (parsed == JobLine::Malformed)
+            {
+                std::cerr << "Job list line " << lineNumber << ": " << error << '\n';
+                ++malformed;
+            }
+            else if (parsed == JobLine::Job)
+            {
+                queue.push({ job, lineNumber, std::chrono::steady_clock::now() });
+                queueChanged.notify_one();
+            }
+        }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        listEnded = true;
+        queueChanged.notify_one();
+    });
+
+    // least recently used first; a scene dropped from here stays alive while the job using it renders
+    std::vector<std::pair<std::string, shared_ptr<Hittable>>> sceneCache;
+    int failed = 0;
+    for (;;)
+    {
+        QueuedJob next;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&] { return !queue.empty() || listEnded; });
+            if (queue.empty())
+                break;
+            next = queue.top();
+            queue.pop();
+        }
+        const RenderJob& j = next.Job_;
+        const auto start = std::chrono::steady_clock::now();
+
+        shared_ptr<Hittable> scene;
+        const auto entry = std::find_if(sceneCache.begin(), sceneCache.end(),
+            [&](const std::pair<std::string, shared_ptr<Hittable>>& _entry) { return _entry.first == j.Scene_; });
+        const bool cached = entry != sceneCache.end();
+        if (cached)
+        {
+            scene = entry->second;
+            sceneCache.erase(entry);
+        }
+        else
+        {
+            // make room first, so the old scene's memory is free before the new one is built
+            while (!sceneCache.empty() && sceneCache.size() >= _maxCachedScenes)
+            {
+                std::cerr << "Dropping scene " << sceneCache.front().first << " from the cache\n";
+                sceneCache.erase(sceneCache.begin());
+            }
+            scene = BuildScene(j.Scene_);
+        }
+        const std::chrono::duration<double> setup = std::chrono::steady_clock::now() - start;
+
+        if (!scene)
+        {
+            ++failed;
+            continue;
+        }
+        if (_maxCachedScenes > 0)
+            sceneCache.emplace_back(j.Scene_, scene);
+        std::ofstream out(j.Output_);
+        if (!out)
+        {
+            std::cerr << "Couldn't write " << j.Output_ << '\n';
+            ++failed;
+            continue;
+        }
+
+        const Camera cam(j.LookFrom_, j.LookAt_, Vec3(0, 1, 0), j.VerticalFov_,
+            static_cast<float>(j.Width_) / static_cast<float>(j.Height_), j.Aperture_, j.FocusDist_);
+        std::unique_ptr<PreviewWriter> preview;
+        if (!_previewPath.empty())
+            preview = std::make_unique<PreviewWriter>(_previewPath, j.Width_, j.Height_, PreviewInterval);
+        RenderOptions options = _options;
+        options.Preview_ = preview.get();
+        options.SortRaysByBlock_ = _options.SortRaysByBlock_ && dynamic_cast<const MappedScene*>(scene.get()) != nullptr;
+        Render(*scene, cam, j.Width_, j.Height_, j.SamplesPerPixel_, maxDepth, out, options);
+
+        const auto end = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> total = end - start;
+        const std::chrono::duration<double> latency = end - next.Arrival_;
+        std::cerr << '\n' << j.Output_ << ": " << total.count() << " s, " << latency.count() << " s since queued";
+        if (cached)
+            std::cerr << " (scene cached)\n";
+        else
+            std::cerr << " (scene built in " << setup.count() << " s)\n";
+    }
+    reader.join();
+    return failed == 0 && malformed == 0 ? 0 : 1;
+}
+
+/**
+ * \brief Check a tree against brute force: for _rays random rays starting near the boxes, the closest box each one enters
+ *	(from outside, so boxes holding the origin don't count) found with TraverseLbvh() must equal the one found by testing
+ *	every box. Catches lost leaves, boxes that don't bound their children, and trees too deep to traverse
+ * \return number of rays on which the two disagree
+ */
+size_t BvhBruteForceMismatches(const std::vector<Aabb>& _boxes, const std::vector<uint32_t>& _order, const std::vector<LbvhNode>& _nodes,
+    size_t _rays) {
+    // same slab arithmetic as Aabb::Hit(), minus the widening, so a box's parents always pass when it does
+    const auto entry = [](const Aabb& _box, const Ray& _r, const Vec3& _invDir, float _tMax) {
+        float tEnter = -static_cast<float>(infinity), tExit = _tMax;
+        for (int a = 0; a < 3; ++a)
+        {
+            float t0 = (_box.Min_[a] - _r.Origin_[a]) * _invDir[a];
+            float t1 = (_box.Max_[a] - _r.Origin_[a]) * _invDir[a];
+            if (_invDir[a] < 0.0f)
+                std::swap(t0, t1);
+            tEnter = t0 > tEnter ? t0 : tEnter;
+            tExit = t1 < tExit ? t1 : tExit;
+        }
+        return tEnter > 0.0f && tEnter <= tExit ? tEnter : _tMax;
+    };
+
+    SeedRandom(2);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < _rays; ++i)
+    {
+        const Aabb& near = _boxes[static_cast<size_t>(RandomFloat(0, static_cast<float>(_boxes.size()))) % _boxes.size()];
+        const Ray r(near.Centroid() + (near.Max_ - near.Min_).Length() * RandomInUnitSphere(), RandomUnitVector());
+        const Vec3 invDir(1.0f / r.Direction_.X(), 1.0f / r.Direction_.Y(), 1.0f / r.Direction_.Z());
+
+        float bruteClosest = static_cast<float>(infinity);
+        for (const Aabb& box : _boxes)
+            bruteClosest = std::min(bruteClosest, entry(box, r, invDir, bruteClosest));
+
+        float treeClosest = static_cast<float>(infinity);
+        TraverseLbvh(_nodes, r, 0.0f, treeClosest, [&](uint32_t _leaf, float& _closest) {
+            const float t = entry(_boxes[_order[_leaf]], r, invDir, _closest);
+            if (!(t < _closest))
+                return false;
+            _closest = t;
+            return true;
+        });
+        if (treeClosest != bruteClosest)
+            ++mismatches;
+    }
+    return mismatches;
+}
+
+/**
+ * \brief Compare the BVH builders on RandomScene() and on RandomSphereSet(_sphereCount):
+ *	build time, SAH cost, depth and the time to render a small image with each, then check every builder's trees
+ *	against brute force, including on nested boxes that make treelet restructuring deepen the tree, and finally
+ *	how the LBVH build scales with threads
+ * \return FALSE if any tree disagreed with brute force
+ */
+bool BvhReport(size_t _sphereCount, std::ostream& _out) {
+    constexpr int imgWidth = 300;
+    constexpr int imgHeight = 200;
+    constexpr int samplesPerPixel = 16;
+    constexpr int maxDepth = 50;
+    const Camera cam(point3(13, 2, 3), point3(0, 0, 0), Vec3(0, 1, 0), 20, 3.0f / 2.0f, 0.1f, 10.0f);
+
+    const std::pair<BvhBuilder, const char*> builders[] = {
+        { BvhBuilder::Lbvh, "lbvh" }, { BvhBuilder::LbvhTreelets, "lbvh+treelets" }, { BvhBuilder::BinnedSah, "binned sah" } };
+    const auto timeRender = [&](const Hittable& _world) {
+        std::ostringstream image;
+        const auto start = std::chrono::steady_clock::now();
+        Render(_world, cam, imgWidth, imgHeight, samplesPerPixel, maxDepth, image, RenderOptions());
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    const auto buildTimed = [](auto&& _build, double& _seconds) {
+        const auto start = std::chrono::steady_clock::now();
+        auto built = _build();
+        _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return built;
+    };
+
+    _out << std::fixed << std::setprecision(3);
+    _out << "scene            builder          build s    SAH cost   depth  render s (" << imgWidth << 'x' << imgHeight << ", " << samplesPerPixel << " spp)\n";
+    for (const auto& builder : builders)
+    {
+        SeedRandom(1);
+        const auto objects = RandomScene().objects;
+        double buildSeconds;
+        const auto world = buildTimed([&] { return make_shared<LinearBvh>(objects, builder.first); }, buildSeconds);
+        _out << std::left << std::setw(17) << "random" << std::setw(17) << builder.second << std::setw(11) << buildSeconds
+            << std::setw(11) << world->SahCost() << std::setw(7) << world->Depth() << timeRender(*world) << '\n';
+    }
+    for (const auto& builder : builders)
+    {
+        SeedRandom(1);
+        double buildSeconds;
+        const auto world = buildTimed([&] { return RandomSphereSet(_sphereCount, builder.first); }, buildSeconds);
+        _out << std::left << std::setw(17) << ("spheres:" + std::to_string(_sphereCount)) << std::setw(17) << builder.second
+            << std::setw(11) << buildSeconds << std::setw(11) << world->SahCost() << std::setw(7) << world->Depth() << timeRender(*world) << '\n';
+    }
+
+    // brute force: every ray tests every box, so keep the box tests per tree around 1e8
+    SeedRandom(1);
+    const auto spheres = RandomSphereSet(_sphereCount, BvhBuilder::Lbvh);
+    std::vector<Aabb> boxes(spheres->SphereCount());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        boxes[i] = spheres->SphereBounds(i);
+    // nested boxes drifting along x: every box holds the previous one, which pushes treelet restructuring deepest
+    std::vector<Aabb> nested(_sphereCount);
+    for (size_t i = 0; i < nested.size(); ++i)
+    {
+        const float size = powf(1.00001f, static_cast<float>(i));
+        nested[i] = Aabb(point3(-0.5f * size, -size, -size), point3(1.5f * size, size, size));
+    }
+    const std::pair<const std::vector<Aabb>*, const char*> boxSets[] = { { &boxes, "sphere boxes" }, { &nested, "nested boxes" } };
+
+    bool agreed = true;
+    _out << "\nbrute force check   builder          depth  rays     mismatches\n";
+    for (const auto& boxSet : boxSets)
+    {
+        const size_t rays = std::max<size_t>(16, std::min<size_t>(10000, 100000000 / boxSet.first->size()));
+        for (const auto& builder : builders)
+        {
+            std::vector<uint32_t> order;
+            std::vector<LbvhNode> nodes;
+            LogBvhBuilds() = false;
+            BuildBvh(builder.first, *boxSet.first, order, nodes);
+            LogBvhBuilds() = true;
+            const size_t mismatches = BvhBruteForceMismatches(*boxSet.first, order, nodes, rays);
+            agreed = agreed && mismatches == 0;
+            _out << std::left << std::setw(20) << boxSet.second << std::setw(17) << builder.second << std::setw(7) << LbvhDepth(nodes)
+                << std::setw(9) << rays << mismatches << '\n';
+        }
+    }
+
+    // build-only scaling: same boxes, thread cap raised until every hardware thread is used
+    _out << "\nLBVH build of " << boxes.size() << " boxes\nthreads  lbvh ms    lbvh+treelets ms\n";
+    const unsigned hardwareThreads = ThreadCount();
+    for (unsigned threads = 1; ; threads = std::min(2 * threads, hardwareThreads))
+    {
+        ThreadLimit() = threads;
+        double ms[2];
+        for (int refine = 0; refine < 2; ++refine)
+        {
+            std::vector<uint32_t> order;
+            std::vector<LbvhNode> nodes;
+            const auto start = std::chrono::steady_clock::now();
+            BuildLbvh(boxes, order, nodes, refine != 0);
+            ms[refine] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        _out << std::setw(9) << threads << std::setw(11) << ms[0] << ms[1] << '\n';
+        if (threads == hardwareThreads)
+            break;
+    }
+    ThreadLimit() = 0;
+    return agreed;
+}
+
+/**
+ * \brief Passes rays through to another Hittable, counting them, so reports can give rays/sec over every bounce
+ */
+class RayCounter : public Hittable
+{
+public:
+    explicit RayCounter(const Hittable& _inner) : inner_(_inner) {}
+
+    long long Rays() const { return rays_.load(); }
+
+    bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const override {
+        rays_.fetch_add(1, std::memory_order_relaxed);
+        return inner_.Hit(_r, _tMin, _tMax, _info);
+    }
+    bool BoundingBox(Aabb& _outBox) const override { return inner_.BoundingBox(_outBox); }
+
+private:
+    const Hittable& inner_;
+    mutable std::atomic<long long> rays_{0};
+};
+
+/**
+ * \brief Load an .obj mesh, set it on a ground sphere and render it through Render() with the camera framing its bounds:
+ *	load time, memory, and camera rays/sec and total rays/sec (every bounce) on all CPUs
+ */
+bool ObjReport(const std::string& _objPath, std::ostream& _out) {
+    constexpr auto aspectRatio = 16.0f / 9.0f;
+    constexpr int imgWidth = 400;
+    constexpr int imgHeight = static_cast<int>(imgWidth / aspectRatio);
+    constexpr int samplesPerPixel = 16;
+    constexpr int maxDepth = 50;
+
+    const auto loadStart = std::chrono::steady_clock::now();
+    auto mesh = LoadObj(_objPath, make_shared<Lambertian>(colorRGB(0.7f, 0.3f, 0.3f)));
+    if (!mesh)
+        return false;
+    const std::chrono::duration<double> loadSeconds = std::chrono::steady_clock::now() - loadStart;
+
+    Aabb bounds;
+    mesh->BoundingBox(bounds);
+    const float size = (bounds.Max_ - bounds.Min_).Length();
+    HittableList scene;
+    scene.Add(mesh);
+    scene.Add(make_shared<Sphere>(point3(bounds.Centroid().X(), bounds.Min_.Y() - 1000.0f * size, bounds.Centroid().Z()),
+        1000.0f * size, make_shared<Lambertian>(colorRGB(0.5f, 0.5f, 0.5f))));
+    const RayCounter world(scene);
+
+    const point3 lookat = bounds.Centroid();
+    const point3 lookfrom = lookat + size * Vec3(0, 0.5f, 1.5f);
+    const Camera cam(lookfrom, lookat, Vec3(0, 1, 0), 40, aspectRatio, 0.0f, (lookfrom - lookat).Length());
+
+    std::ostringstream image;
+    const auto start = std::chrono::steady_clock::now();
+    Render(world, cam, imgWidth, imgHeight, samplesPerPixel, maxDepth, image, RenderOptions());
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double cameraRays = static_cast<double>(imgWidth) * (imgHeight + 1) * samplesPerPixel;
+
+    _out << _objPath << ": " << mesh->TriangleCount() << " triangles, " << mesh->Vertices_.size() << " vertices, "
+        << mesh->MemoryUsage() / (1024 * 1024) << " MiB, loaded and built in " << loadSeconds.count() << " s\n"
+        << imgWidth << 'x' << imgHeight << ", " << samplesPerPixel << " spp: " << seconds << " s, "
+        << static_cast<long long>(cameraRays / seconds) << " camera rays/sec, " << static_cast<long long>(world.Rays() / seconds) << " rays/sec\n";
+    return true;
+}
+
+/**
+ * \brief With no arguments, render the final scene to stdout.
+ *	With a job list ("-" for stdin), render its jobs as their lines arrive, reusing scenes between jobs, see RenderJobs().
+ *	Options, before the job list if there is one: "--pin [threads]" pins render threads to CPUs node by node and gives each NUMA node
+ *	a replica of the world (one thread per CPU unless a count follows, see RenderOptions::PinThreads_),
+ *	"--sort-rays" traces scene files in block-sorted ray queues, "--preview file.ppm"
+ *	streams a progressive preview of whatever is rendering (preview.ppm for the final scene), "--scene-cache N" keeps
+ *	up to N built scenes between jobs (4 by default), "--seed N" renders an independent set of samples.
+ *	"--fastmath-report" and "--compare a.ppm b.ppm [c.ppm]" validate RT_FAST_MATH builds, see fastMathReport.h.
+ *	"--bvh-report [sphere count]" compares the BVH builders, see BvhReport().
+ *	"--obj-report file.obj" measures trace speed on a mesh, see ObjReport().
+ *	"--write-scene file.rtscene <sphere count> [full|quantized]" writes a RandomSphereSet()-like field to a scene file,
+ *	which job lists can then render out of core, see WriteRandomSphereFile() and MappedScene
+ */
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--fastmath-report")
+    {
+        FastMath_ErrorReport(std::cout);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bvh-report")
+        return BvhReport(argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000, std::cout) ? 0 : 1;
+    if (argc > 2 && std::string(argv[1]) == "--obj-report")
+        return ObjReport(argv[2], std::cout) ? 0 : 1;
+    if (argc > 3 && std::string(argv[1]) == "--write-scene")
+    {
+        const bool full = argc > 4 && std::string(argv[4]) == "full";
+        return WriteRandomSphereFile(argv[2], strtoull(argv[3], nullptr, 10), full ? SceneNodeEncoding::Full : SceneNodeEncoding::Quantized) ? 0 : 1;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--compare")
+        return CompareImages(argv[2], argv[3], argc > 4 ? argv[4] : "", std::cout) ? 0 : 1;
+
+    RenderOptions options;
+    std::string previewPath;
+    size_t maxCachedScenes = 4;
+    int arg = 1;
+    for (; arg < argc; ++arg)
+    {
+        const std::string flag = argv[arg];
+        if (flag == "--sort-rays")
+            options.SortRaysByBlock_ = true;
+        else if (flag == "--pin")
+        {
+            options.PinThreads_ = true;
+            char* end = nullptr;
+            const unsigned long threads = arg + 1 < argc ? strtoul(argv[arg + 1], &end, 10) : 0;
+            if (threads > 0 && *end == '\0')
+            {
+                options.Threads_ = static_cast<unsigned>(threads);
+                ++arg;
+            }
+        }
+        else if (flag == "--preview" && arg + 1 < argc)
+            previewPath = argv[++arg];
+        else if (flag == "--seed" && arg + 1 < argc)
+            options.SampleSeed_ = static_cast<unsigned>(strtoul(argv[++arg], nullptr, 10));
+        else if (flag == "--scene-cache" && arg + 1 < argc)
+            maxCachedScenes = strtoul(argv[++arg], nullptr, 10);
+        else
+            break;
+    }
+    if (arg < argc)
+    {
+        const std::string jobListPath = argv[arg];
+        if (jobListPath == "-")
+            return RenderJobs(std::cin, options, previewPath, maxCachedScenes);
+        std::ifstream jobList(jobListPath);
+        if (!jobList)
+        {
+            std::cerr << "Couldn't open job list " << jobListPath << '\n';
+            return 1;
+        }
+        return RenderJobs(jobList, options, previewPath, maxCachedScenes);
+    }
+
     // Image Properties
     constexpr auto aspectRatio = 3.0f / 2.0f;
     constexpr int imgWidth = 1200;  // pixels
@@ -192,8 +1060,12 @@ int main() {
     constexpr int samplesPerPixel = 500;
     constexpr int maxDepth = 50;
 
+    // Live preview, rewritten every PreviewInterval while rendering
+    if (previewPath.empty())
+        previewPath = "preview.ppm";
+
     // World
-    HittableList world = RandomScene();
+    LinearBvh world(RandomScene().objects);
 
     // Camera
     point3 lookfrom(13, 2, 3);
@@ -205,26 +1077,15 @@ int main() {
     Camera cam(lookfrom, lookat, vup, 20, aspectRatio, aperture, dist_to_focus);
     //Camera cam(point3(-2, 2, 1), point3(0, 0, -1), Vec3(0, 1, 0), 90, aspectRatio);
 
-    // Render the image:
-    std::cout << "P3\n" << imgWidth << ' ' << imgHeight << "\n255\n";
-    for (int row = imgHeight; row >= 0; --row)
-    {
-        // Progress indicator
-        std::cerr << "\rScan lines remaining: " << row << ' ' << std::flush;
+    const auto preview = std::make_unique<PreviewWriter>(previewPath, imgWidth, imgHeight, PreviewInterval);
+    options.SortRaysByBlock_ = false; // the world isn't paged in from a scene file
+    options.Preview_ = preview.get();
 
-        // Create the image pixel-by-pixel
-        for (int col = 0; col < imgWidth; ++col)
-        {
-            colorRGB pixelColor(0, 0, 0);
-            for (int s = 0; s < samplesPerPixel; ++s)
-            {
-                const auto u = (col + RandomFloat()) / (imgWidth - 1.0f);
-                const auto v = (row + RandomFloat()) / (imgHeight - 1.0f);
-                Ray r = cam.GetRay(u, v);
-                pixelColor += Ray_Color_LambertHemisphere(r, world, maxDepth);
-            }
-            Write_Color(std::cout, pixelColor, samplesPerPixel);
-        }
-    }
-    std::cerr << "\nDone!\n";
+    // Render the image:
+    const auto start = std::chrono::steady_clock::now();
+    Render(world, cam, imgWidth, imgHeight, samplesPerPixel, maxDepth, std::cout, options);
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cerr << "\nDone! " << seconds.count() << " s, preview overhead on the render threads: "
+        << std::chrono::duration<double, std::milli>(preview->SubmitTime()).count() << " ms\n";
+    return 0;
 }
\ No newline at end of file
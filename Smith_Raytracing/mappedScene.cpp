@@ -0,0 +1,347 @@
+#include "mappedScene.h"
+
+#include "material.h"
+#include "sphere.h"
+
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	Aabb ChunkBounds(const SceneChunk& _chunk) {
+		return Aabb(point3(_chunk.Min_[0], _chunk.Min_[1], _chunk.Min_[2]), point3(_chunk.Max_[0], _chunk.Max_[1], _chunk.Max_[2]));
+	}
+
+	float SurfaceArea(const Aabb& _box) {
+		const Vec3 e = _box.Max_ - _box.Min_;
+		return 2.0f * (e.X() * e.Y() + e.Y() * e.Z() + e.Z() * e.X());
+	}
+
+	/**
+	 * \brief Decode child _child of a QuantizedNode
+	 */
+	Aabb ChildBounds(const QuantizedNode& _node, int _child) {
+		Aabb box;
+		for (int a = 0; a < 3; ++a)
+		{
+			const float scale = QuantizedScale(_node.Exponent_[a]);
+			box.Min_[a] = _node.Origin_[a] + static_cast<float>(_node.Min_[_child][a]) * scale;
+			box.Max_[a] = _node.Origin_[a] + static_cast<float>(_node.Max_[_child][a]) * scale;
+		}
+		return box;
+	}
+
+	bool InRange(uint64_t _offset, uint64_t _bytes, uint64_t _size) {
+		return _offset <= _size && _bytes <= _size - _offset;
+	}
+}
+
+MappedScene::MappedScene(const std::string& _path)
+{
+	if (!Open(_path))
+		Close();
+}
+
+MappedScene::~MappedScene()
+{
+	Close();
+}
+
+bool MappedScene::Open(const std::string& _path)
+{
+	path_ = _path;
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Couldn't open scene file " << _path << '\n';
+		return false;
+	}
+	file_ = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX)
+	{
+		std::cerr << "Scene file " << _path << " is too big to map in this address space\n";
+		return false;
+	}
+	size_ = static_cast<uint64_t>(size.QuadPart);
+	mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_)
+		data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+	file_ = open(_path.c_str(), O_RDONLY);
+	if (file_ < 0)
+	{
+		std::cerr << "Couldn't open scene file " << _path << '\n';
+		return false;
+	}
+	struct stat info;
+	if (fstat(file_, &info) != 0 || static_cast<uint64_t>(info.st_size) > SIZE_MAX)
+	{
+		std::cerr << "Scene file " << _path << " is too big to map in this address space\n";
+		return false;
+	}
+	size_ = static_cast<uint64_t>(info.st_size);
+	if (size_ > 0)
+	{
+		void* data = mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_SHARED, file_, 0);
+		data_ = data == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(data);
+		// rays jump between chunks: default readahead would pull in megabytes per fault only to evict them again
+		if (data_)
+			madvise(data, static_cast<size_t>(size_), MADV_RANDOM);
+	}
+#endif
+	if (!data_)
+	{
+		std::cerr << "Couldn't map scene file " << _path << '\n';
+		return false;
+	}
+
+	// validate the structure: header, tables and every block must lie inside the file
+	SceneFileHeader header;
+	if (size_ < sizeof(header))
+	{
+		std::cerr << "Scene file " << _path << " is truncated\n";
+		return false;
+	}
+	memcpy(&header, data_, sizeof(header));
+	if (memcmp(header.Magic_, "RTSCENE", 8) != 0 || header.Version_ != SceneFileVersion
+		|| header.Encoding_ > static_cast<uint32_t>(SceneNodeEncoding::Quantized))
+	{
+		std::cerr << _path << " isn't a version " << SceneFileVersion << " scene file\n";
+		return false;
+	}
+	encoding_ = static_cast<SceneNodeEncoding>(header.Encoding_);
+	if (header.ChunkCount_ == 0 || header.ChunkCount_ > UINT32_MAX
+		|| !InRange(header.ChunkTableOffset_, header.ChunkCount_ * sizeof(SceneChunk), size_)
+		|| header.ChunkTableOffset_ % alignof(SceneChunk) != 0
+		|| !InRange(header.MaterialOffset_, header.MaterialCount_ * sizeof(SceneMaterial), size_))
+	{
+		std::cerr << "Scene file " << _path << " has a broken chunk or material table\n";
+		return false;
+	}
+	chunks_ = reinterpret_cast<const SceneChunk*>(data_ + header.ChunkTableOffset_);
+	chunkCount_ = static_cast<size_t>(header.ChunkCount_);
+	brokenChunks_.reset(new std::atomic<bool>[chunkCount_]);
+	for (size_t c = 0; c < chunkCount_; ++c)
+		brokenChunks_[c] = false;
+	sphereCount_ = header.SphereCount_;
+
+	const size_t nodeSize = encoding_ == SceneNodeEncoding::Quantized ? sizeof(QuantizedNode) : sizeof(LbvhNode);
+	for (size_t c = 0; c < chunkCount_; ++c)
+	{
+		const SceneChunk& chunk = chunks_[c];
+		const uint64_t expectedNodes = encoding_ == SceneNodeEncoding::Quantized ? chunk.SphereCount_ - 1ull : 2ull * chunk.SphereCount_ - 1;
+		if (chunk.SphereCount_ == 0 || chunk.NodeCount_ != expectedNodes
+			|| chunk.NodeOffset_ % SceneFileBlockAlignment != 0 || chunk.SphereOffset_ % SceneFileBlockAlignment != 0
+			|| !InRange(chunk.NodeOffset_, static_cast<uint64_t>(chunk.NodeCount_) * nodeSize, size_)
+			|| !InRange(chunk.SphereOffset_, static_cast<uint64_t>(chunk.SphereCount_) * sizeof(SphereSet::Entry), size_))
+		{
+			std::cerr << "Scene file " << _path << ": chunk " << c << " is broken\n";
+			return false;
+		}
+	}
+
+	for (uint64_t m = 0; m < header.MaterialCount_; ++m)
+	{
+		SceneMaterial record;
+		memcpy(&record, data_ + header.MaterialOffset_ + m * sizeof(SceneMaterial), sizeof(record));
+		const colorRGB albedo(record.Albedo_[0], record.Albedo_[1], record.Albedo_[2]);
+		if (record.Type_ == SceneMaterial::Metal)
+			materials_.push_back(make_shared<Metal>(albedo, record.Parameter_));
+		else if (record.Type_ == SceneMaterial::Dielectric)
+			materials_.push_back(make_shared<Dielectric>(record.Parameter_));
+		else
+			materials_.push_back(make_shared<Lambertian>(albedo));
+	}
+	if (materials_.empty()) // spheres still need something to scatter with
+		materials_.push_back(make_shared<Lambertian>(colorRGB(0.5f, 0.5f, 0.5f)));
+
+	// the only tree kept in memory: one leaf per chunk
+	std::vector<Aabb> boxes(chunkCount_);
+	chunkAreas_.resize(chunkCount_);
+	for (size_t c = 0; c < chunkCount_; ++c)
+	{
+		boxes[c] = ChunkBounds(chunks_[c]);
+		chunkAreas_[c] = SurfaceArea(boxes[c]);
+	}
+	BuildLbvh(boxes, topOrder_, topNodes_);
+
+	std::cerr << "MappedScene: " << _path << ": " << sphereCount_ << " spheres in " << chunkCount_ << " chunks, "
+		<< size_ / (1024 * 1024) << " MiB mapped, " << MemoryUsage() / 1024 << " KiB in memory\n";
+	return true;
+}
+
+void MappedScene::Close()
+{
+#if defined(_WIN32)
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle(mapping_);
+	if (file_)
+		CloseHandle(file_);
+	mapping_ = nullptr;
+	file_ = nullptr;
+#else
+	if (data_)
+		munmap(const_cast<unsigned char*>(data_), static_cast<size_t>(size_));
+	if (file_ >= 0)
+		close(file_);
+	file_ = -1;
+#endif
+	data_ = nullptr;
+}
+
+bool MappedScene::HitChunk(const SceneChunk& _chunk, const Ray& _r, float _tMin, float& _closestSoFar,
+	const SphereSet::Entry*& _sphereHit) const
+{
+	const auto* spheres = reinterpret_cast<const SphereSet::Entry*>(data_ + _chunk.SphereOffset_);
+	const auto hitSphere = [&](uint32_t _sphere, float& _closest) {
+		if (!Sphere::Intersect(spheres[_sphere].Center_, spheres[_sphere].Radius_, _r, _tMin, _closest, _closest))
+			return false;
+		_sphereHit = &spheres[_sphere];
+		return true;
+	};
+
+	if (brokenChunks_[&_chunk - chunks_].load(std::memory_order_relaxed))
+		return false;
+
+	bool malformed = false;
+	bool hitAnything = false;
+	if (encoding_ == SceneNodeEncoding::Full)
+	{
+		hitAnything = TraverseLbvh(reinterpret_cast<const LbvhNode*>(data_ + _chunk.NodeOffset_), _chunk.NodeCount_,
+			_r, _tMin, _closestSoFar, hitSphere, &malformed);
+		if (malformed)
+			ReportCorruption(_chunk);
+		return hitAnything;
+	}
+
+	// quantized: children's boxes are decoded from their parent. Spheres also get their exact box tested, as a leaf
+	// node would, so grazing rays are decided exactly like with full nodes
+	const Vec3 invDir(1.0f / _r.Direction_.X(), 1.0f / _r.Direction_.Y(), 1.0f / _r.Direction_.Z());
+	const auto hitLeaf = [&](uint32_t _sphere) {
+		const float r = fabs(spheres[_sphere].Radius_);
+		const Aabb box(spheres[_sphere].Center_ - Vec3(r, r, r), spheres[_sphere].Center_ + Vec3(r, r, r));
+		return box.Hit(_r, invDir, _tMin, _closestSoFar) && hitSphere(_sphere, _closestSoFar);
+	};
+	if (_chunk.NodeCount_ == 0)
+		return hitLeaf(0);
+
+	// children come from the file, so check them like TraverseLbvh() does before following them
+	const auto* nodes = reinterpret_cast<const QuantizedNode*>(data_ + _chunk.NodeOffset_);
+	uint32_t stack[LbvhStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	uint32_t visits = 0;
+	while (stackSize > 0 && !malformed)
+	{
+		const QuantizedNode& node = nodes[stack[--stackSize]];
+		malformed = ++visits > _chunk.NodeCount_;
+		for (int c = 0; c < 2 && !malformed; ++c)
+		{
+			if (!ChildBounds(node, c).Hit(_r, invDir, _tMin, _closestSoFar))
+				continue;
+			if (node.Leaves_ & (1 << c))
+			{
+				malformed = node.Child_[c] >= _chunk.SphereCount_;
+				if (!malformed)
+					hitAnything |= hitLeaf(node.Child_[c]);
+			}
+			else
+			{
+				malformed = node.Child_[c] >= _chunk.NodeCount_ || stackSize == LbvhStackSize;
+				if (!malformed)
+					stack[stackSize++] = node.Child_[c];
+			}
+		}
+	}
+	if (malformed)
+		ReportCorruption(_chunk);
+	return hitAnything;
+}
+
+void MappedScene::ReportCorruption(const SceneChunk& _chunk) const
+{
+	const ptrdiff_t chunk = &_chunk - chunks_;
+	brokenChunks_[chunk].store(true, std::memory_order_relaxed);
+	if (!reportedCorruption_.exchange(true, std::memory_order_relaxed))
+		std::cerr << "Scene file " << path_ << ": chunk " << chunk << " has a broken BVH, it and any other broken chunk are left out\n";
+}
+
+bool MappedScene::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const
+{
+	float closestSoFar = _tMax;
+	const SphereSet::Entry* sphereHit = nullptr;
+	TraverseLbvh(topNodes_, _r, _tMin, closestSoFar, [&](uint32_t _leaf, float& _closest) {
+		return HitChunk(chunks_[topOrder_[_leaf]], _r, _tMin, _closest, sphereHit);
+	});
+	if (!sphereHit)
+		return false;
+
+	// Hit! Only fill in the record once, for the closest sphere
+	const SphereSet::Entry sphere = *sphereHit;
+	_info.T_ = closestSoFar;
+	_info.P_ = _r.At(_info.T_);
+	_info.SetFaceNormal(_r, (_info.P_ - sphere.Center_) / sphere.Radius_);
+	_info.MaterialPtr_ = materials_[sphere.Material_ < materials_.size() ? sphere.Material_ : 0];
+	return true;
+}
+
+bool MappedScene::BoundingBox(Aabb& _outBox) const
+{
+	if (topNodes_.empty())
+		return false;
+	_outBox = topNodes_[0].Bounds_;
+	return true;
+}
+
+uint32_t MappedScene::BlockKey(const Ray& _r) const
+{
+	const Vec3 invDir(1.0f / _r.Direction_.X(), 1.0f / _r.Direction_.Y(), 1.0f / _r.Direction_.Z());
+	uint32_t inside = UINT32_MAX, entered = UINT32_MAX;
+	float insideArea = static_cast<float>(infinity), firstEntry = static_cast<float>(infinity);
+
+	float unbounded = static_cast<float>(infinity);
+	TraverseLbvh(topNodes_, _r, 0.0f, unbounded, [&](uint32_t _leaf, float&) {
+		const uint32_t chunk = topOrder_[_leaf];
+		const Aabb box = ChunkBounds(chunks_[chunk]);
+		bool contains = true;
+		float entry = 0.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			contains = contains && _r.Origin_[a] >= box.Min_[a] && _r.Origin_[a] <= box.Max_[a];
+			const float t = ((invDir[a] < 0.0f ? box.Max_[a] : box.Min_[a]) - _r.Origin_[a]) * invDir[a];
+			entry = t > entry ? t : entry;
+		}
+		if (contains && chunkAreas_[chunk] < insideArea)
+		{
+			inside = chunk;
+			insideArea = chunkAreas_[chunk];
+		}
+		else if (!contains && entry < firstEntry)
+		{
+			entered = chunk;
+			firstEntry = entry;
+		}
+		return false;
+	});
+	return inside != UINT32_MAX ? inside : entered;
+}
+
+shared_ptr<MappedScene> OpenSceneFile(const std::string& _path)
+{
+	auto scene = make_shared<MappedScene>(_path);
+	return scene->IsOpen() ? scene : nullptr;
+}
@@ -0,0 +1,92 @@
+#ifndef MAPPED_SCENE_H
+#define MAPPED_SCENE_H
+
+#include "sceneFile.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief A scene file (see sceneFile.h) memory-mapped read-only, so the operating system pages chunks in as rays
+ *	reach them and drops them again under memory pressure: scenes can be several times bigger than RAM.
+ *	Only the chunk table, a small BVH over the chunks and the materials are kept in memory.
+ */
+class MappedScene : public Hittable
+{
+public:
+	// - Constructors - //
+	/**
+	 * \param _path scene file written by SceneFileWriter. Check IsOpen() afterwards
+	 */
+	explicit MappedScene(const std::string& _path);
+	~MappedScene();
+	MappedScene(const MappedScene&) = delete;
+	MappedScene& operator=(const MappedScene&) = delete;
+
+	// - Getters - //
+	bool IsOpen() const { return data_ != nullptr; }
+	uint64_t SphereCount() const { return sphereCount_; }
+	size_t ChunkCount() const { return chunkCount_; }
+	uint64_t MappedBytes() const { return size_; }
+	/**
+	 * \return heap footprint in bytes, everything else stays in the file
+	 */
+	size_t MemoryUsage() const {
+		return topNodes_.capacity() * sizeof(LbvhNode) + topOrder_.capacity() * sizeof(uint32_t) + chunkAreas_.capacity() * sizeof(float)
+			+ chunkCount_ * sizeof(std::atomic<bool>);
+	}
+
+	// - Methods - //
+	bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const override;
+	bool BoundingBox(Aabb& _outBox) const override;
+	/**
+	 * \return index of the smallest chunk holding the ray's origin or, if there is none, of the first chunk the ray enters.
+	 *	Chunks are numbered in file order, so nearby keys are nearby in the file too
+	 */
+	uint32_t BlockKey(const Ray& _r) const override;
+
+private:
+	bool Open(const std::string& _path);
+	void Close();
+	/**
+	 * \brief Trace one chunk's spheres. Open() only checks that each chunk lies inside the file, reading every node up
+	 *	front would page the whole scene in, so the walk itself checks each child before following it
+	 */
+	bool HitChunk(const SceneChunk& _chunk, const Ray& _r, float _tMin, float& _closestSoFar, const SphereSet::Entry*& _sphereHit) const;
+	/**
+	 * \brief Leave a chunk whose BVH no SceneFileWriter wrote out of every later ray, and say so once on stderr
+	 */
+	void ReportCorruption(const SceneChunk& _chunk) const;
+
+	std::string path_;
+
+	const unsigned char* data_ = nullptr;
+	uint64_t size_ = 0;
+#if defined(_WIN32)
+	void* file_ = nullptr;		// HANDLEs, kept as void* so this header doesn't need windows.h
+	void* mapping_ = nullptr;
+#else
+	int file_ = -1;
+#endif
+
+	SceneNodeEncoding encoding_ = SceneNodeEncoding::Full;
+	const SceneChunk* chunks_ = nullptr;
+	size_t chunkCount_ = 0;
+	uint64_t sphereCount_ = 0;
+	std::vector<shared_ptr<Material>> materials_;
+	std::vector<LbvhNode> topNodes_;	// BVH over the chunks' bounds
+	std::vector<uint32_t> topOrder_;	// chunk index of each top level leaf
+	std::vector<float> chunkAreas_;
+	std::unique_ptr<std::atomic<bool>[]> brokenChunks_;	// set by ReportCorruption()
+	mutable std::atomic<bool> reportedCorruption_{ false };
+};
+
+/**
+ * \brief Map a scene file
+ * \return nullptr if it can't be opened or isn't a valid scene file
+ */
+shared_ptr<MappedScene> OpenSceneFile(const std::string& _path);
+
+#endif
@@ -111,7 +111,11 @@ private:
 	static float Reflectance(float _cosine, float _refIdx) {
 		auto r0 = (1.0f - _refIdx) / (1.0f + _refIdx);
 		r0 = r0 * r0;
+#ifdef RT_FAST_MATH
+		return r0 + (1.0f - r0) * Pow5(1.0f - _cosine);
+#else
 		return r0 + (1.0f - r0) * pow((1.0f - _cosine), 5.0f);
+#endif
 	}
 };
 
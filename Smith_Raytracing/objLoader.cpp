@@ -0,0 +1,101 @@
+#include "objLoader.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	/**
+	 * \brief Resolve an obj face index (1-based, or negative = relative to the end) to a 0-based one
+	 * \return FALSE if the index points outside the vertices read so far
+	 */
+	bool ResolveIndex(long _objIndex, size_t _vertexCount, uint32_t& _out) {
+		const long resolved = _objIndex > 0 ? _objIndex - 1 : static_cast<long>(_vertexCount) + _objIndex;
+		if (_objIndex == 0 || resolved < 0 || static_cast<size_t>(resolved) >= _vertexCount)
+			return false;
+		_out = static_cast<uint32_t>(resolved);
+		return true;
+	}
+}
+
+shared_ptr<TriangleMesh> LoadObj(const std::string& _path, shared_ptr<Material> _mat)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	std::ifstream file(_path);
+	if (!file)
+	{
+		std::cerr << "LoadObj: couldn't open " << _path << '\n';
+		return nullptr;
+	}
+
+	std::vector<point3> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> face;	// reused between lines to avoid reallocating
+	std::string line;
+	size_t skippedFaces = 0;
+
+	while (std::getline(file, line))
+	{
+		const char* c = line.c_str();
+		while (*c == ' ' || *c == '\t') ++c;
+
+		if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			char* end = nullptr;
+			const float x = strtof(c + 1, &end);
+			const float y = strtof(end, &end);
+			const float z = strtof(end, &end);
+			vertices.emplace_back(x, y, z);
+		}
+		else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			// each corner is "v", "v/vt", "v//vn" or "v/vt/vn"; only v matters here
+			face.clear();
+			bool valid = true;
+			const char* p = c + 1;
+			while (true)
+			{
+				char* end = nullptr;
+				const long objIndex = strtol(p, &end, 10);
+				if (end == p)
+					break;
+				uint32_t index = 0;
+				valid = valid && ResolveIndex(objIndex, vertices.size(), index);
+				face.push_back(index);
+				p = end;
+				while (*p != '\0' && *p != ' ' && *p != '\t') ++p; // skip the /vt/vn part
+			}
+
+			if (!valid || face.size() < 3)
+			{
+				++skippedFaces;
+				continue;
+			}
+			for (size_t i = 1; i + 1 < face.size(); ++i)
+			{
+				indices.push_back(face[0]);
+				indices.push_back(face[i]);
+				indices.push_back(face[i + 1]);
+			}
+		}
+	}
+
+	if (indices.empty())
+	{
+		std::cerr << "LoadObj: no triangles in " << _path << '\n';
+		return nullptr;
+	}
+
+	auto mesh = make_shared<TriangleMesh>(std::move(vertices), std::move(indices), std::move(_mat));
+
+	const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << "LoadObj: " << _path << ": " << mesh->TriangleCount() << " triangles, "
+		<< mesh->Vertices_.size() << " vertices, " << mesh->MemoryUsage() / (1024 * 1024) << " MiB, "
+		<< ms << " ms (load + BVH)";
+	if (skippedFaces > 0)
+		std::cerr << ", skipped " << skippedFaces << " bad faces";
+	std::cerr << '\n';
+	return mesh;
+}
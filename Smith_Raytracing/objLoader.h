@@ -0,0 +1,17 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "triangleMesh.h"
+
+#include <string>
+
+/**
+ * \brief Stream a Wavefront .obj file into a TriangleMesh, one line at a time.
+ *	Only positions ("v") and faces ("f") are read; polygons are fan-triangulated, everything else is skipped.
+ * \param _path file to load
+ * \param _mat material for the whole mesh
+ * \return the mesh, or nullptr if the file can't be opened or holds no triangles
+ */
+shared_ptr<TriangleMesh> LoadObj(const std::string& _path, shared_ptr<Material> _mat);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Cap on the threads ParallelChunks()/ParallelFor() use, 0 = one per hardware thread.
+ *	Lets reports measure how a parallel step scales with thread count
+ */
+inline unsigned& ThreadLimit() {
+	static unsigned limit = 0;
+	return limit;
+}
+
+/**
+ * \return number of worker threads to use (at least 1)
+ */
+inline unsigned ThreadCount() {
+	const unsigned hardware = std::thread::hardware_concurrency();
+	const unsigned n = hardware > 0 ? hardware : 1;
+	return ThreadLimit() > 0 && ThreadLimit() < n ? ThreadLimit() : n;
+}
+
+/**
+ * \brief Split [0, _count) into one contiguous chunk per thread and run _fn(chunkIndex, begin, end) on each.
+ *	Chunk 0 runs on the calling thread. Small ranges (< _minPerThread items per thread) use fewer threads.
+ * \return number of chunks the range was split into
+ */
+template <typename Fn>
+unsigned ParallelChunks(size_t _count, size_t _minPerThread, Fn _fn) {
+	const size_t maxChunks = std::max<size_t>(1, _count / std::max<size_t>(1, _minPerThread));
+	const auto chunks = static_cast<unsigned>(std::min<size_t>(ThreadCount(), maxChunks));
+	const size_t perChunk = (_count + chunks - 1) / chunks;
+
+	std::vector<std::thread> workers;
+	workers.reserve(chunks - 1);
+	for (unsigned c = 1; c < chunks; ++c)
+	{
+		const size_t begin = std::min(_count, c * perChunk);
+		const size_t end = std::min(_count, begin + perChunk);
+		workers.emplace_back(_fn, c, begin, end);
+	}
+	_fn(0u, size_t(0), std::min(_count, perChunk));
+
+	for (auto& worker : workers)
+		worker.join();
+	return chunks;
+}
+
+/**
+ * \brief Run _fn(i) for every i in [0, _count), spread across threads
+ */
+template <typename Fn>
+void ParallelFor(size_t _count, size_t _minPerThread, Fn _fn) {
+	ParallelChunks(_count, _minPerThread, [&_fn](unsigned, size_t _begin, size_t _end) {
+		for (size_t i = _begin; i < _end; ++i)
+			_fn(i);
+	});
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "preview.h"
+
+#include "color.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+PreviewWriter::PreviewWriter(std::string _path, int _width, int _height, std::chrono::milliseconds _interval)
+	: path_(std::move(_path)), width_(_width), height_(_height), interval_(_interval),
+	  pending_(static_cast<size_t>(_width) * _height), frame_(static_cast<size_t>(_width) * _height), rowSamples_(_height, 0)
+{
+	writer_ = std::thread(&PreviewWriter::WriterLoop, this);
+}
+
+PreviewWriter::~PreviewWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_one();
+	writer_.join();
+}
+
+void PreviewWriter::SubmitRow(int _row, const colorRGB* _pixels, int _samples)
+{
+	if (_row < 0 || _row >= height_)
+		return;
+
+	const auto start = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::copy(_pixels, _pixels + width_, pending_.begin() + static_cast<size_t>(_row) * width_);
+		pendingRows_.emplace_back(_row, _samples);
+	}
+	submitNanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PreviewWriter::WriterLoop()
+{
+	std::vector<colorRGB> incoming(pending_.size());
+	std::vector<std::pair<int, int>> rows;
+	bool stopping = false;
+
+	while (!stopping)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait_for(lock, interval_, [this] { return stop_; });
+			stopping = stop_;
+			if (pendingRows_.empty())
+				continue;
+			// swap, never copy, under the lock: render threads submitting rows wait for a few pointers at most
+			pending_.swap(incoming);
+			pendingRows_.swap(rows);
+		}
+
+		// incoming holds up to date pixels for the listed rows only; the rest is whatever the buffer held before
+		for (const auto& row : rows)
+		{
+			const auto begin = incoming.begin() + static_cast<size_t>(row.first) * width_;
+			std::copy(begin, begin + width_, frame_.begin() + static_cast<size_t>(row.first) * width_);
+			rowSamples_[row.first] = row.second;
+		}
+		rows.clear();
+		WriteFile();
+	}
+}
+
+void PreviewWriter::WriteFile() const
+{
+	const std::string tempPath = path_ + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary);
+		if (!out)
+			return;
+
+		out << "P6\n" << width_ << ' ' << height_ << "\n255\n";
+		std::vector<char> bytes(frame_.size() * 3, 0); // rows nothing was submitted for yet stay black
+		for (size_t i = 0; i < frame_.size(); ++i)
+		{
+			const int samples = rowSamples_[i / width_];
+			if (samples == 0)
+				continue;
+			int r, g, b;
+			To_Bytes(frame_[i], samples, r, g, b);
+			bytes[3 * i] = static_cast<char>(r);
+			bytes[3 * i + 1] = static_cast<char>(g);
+			bytes[3 * i + 2] = static_cast<char>(b);
+		}
+		out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	// POSIX rename() atomically replaces the old preview. Windows' won't overwrite, so there (only) the old file
+	// has to go first, leaving a brief window without one
+#ifdef _WIN32
+	std::remove(path_.c_str());
+#endif
+	std::rename(tempPath.c_str(), path_.c_str());
+}
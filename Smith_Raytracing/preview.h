@@ -0,0 +1,77 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "rtweekend.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Live preview of a render in progress.
+ *	The render loop hands over scan lines as they gain samples (Render() makes a quick low-sample pass over the whole
+ *	frame first, then refines it); a background thread periodically writes the latest version of every row to a binary
+ *	PPM via a temp file + rename, so viewers never see half a file (and on POSIX, never a missing one).
+ *	Point any image viewer that auto-reloads at the file to watch the render, e.g. `feh --reload 1 preview.ppm`.
+ */
+class PreviewWriter
+{
+public:
+	// - Constructors - //
+	/**
+	 * \param _path file to (re)write the preview to
+	 * \param _width image width in pixels
+	 * \param _height image height in pixels
+	 * \param _interval minimum time between two writes of the preview
+	 */
+	PreviewWriter(std::string _path, int _width, int _height, std::chrono::milliseconds _interval);
+	~PreviewWriter(); // writes the final preview and joins the writer thread
+
+	PreviewWriter(const PreviewWriter&) = delete;
+	PreviewWriter& operator=(const PreviewWriter&) = delete;
+
+	// - Methods - //
+	/**
+	 * \brief Publish the current state of a scan line, replacing what was submitted for it before.
+	 *	Only copies the pixels; the file write happens on the writer thread. Safe to call from several render threads at once
+	 * \param _row row of the image, 0 = top. Rows outside the image are ignored
+	 * \param _pixels _width accumulated (not yet averaged) colors
+	 * \param _samples samples accumulated into each pixel so far
+	 */
+	void SubmitRow(int _row, const colorRGB* _pixels, int _samples);
+
+	/**
+	 * \return total time render threads have spent inside SubmitRow, i.e. the overhead the preview adds to them
+	 */
+	std::chrono::nanoseconds SubmitTime() const { return std::chrono::nanoseconds(submitNanos_.load()); }
+
+private:
+	void WriterLoop();
+	void WriteFile() const;
+
+	std::string path_;
+	int width_;
+	int height_;
+	std::chrono::milliseconds interval_;
+
+	// render threads copy rows into pending_ and list them in pendingRows_. The writer swaps both with buffers of
+	// its own under the lock, which is O(1), then merges the listed rows into frame_ without holding it
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::vector<colorRGB> pending_;				// guarded by mutex_
+	std::vector<std::pair<int, int>> pendingRows_;	// guarded by mutex_. (row, samples) submitted since the last swap
+	bool stop_ = false;							// guarded by mutex_
+
+	std::vector<colorRGB> frame_;	// writer thread only, like rowSamples_
+	std::vector<int> rowSamples_;
+	std::atomic<long long> submitNanos_{0};	// summed over all render threads
+
+	std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "renderJob.h"
+
+#include <cstdlib>
+#include <sstream>
+
+JobLine ParseRenderJob(const std::string& _line, RenderJob& _job, std::string& _error)
+{
+	std::istringstream in(_line);
+	if (!(in >> _job.Scene_) || _job.Scene_[0] == '#')
+		return JobLine::Skip;
+
+	float x, y, z, ax, ay, az;
+	if (!(in >> _job.Output_ >> _job.Width_ >> _job.Height_ >> _job.SamplesPerPixel_
+		>> x >> y >> z >> ax >> ay >> az
+		>> _job.VerticalFov_ >> _job.Aperture_ >> _job.FocusDist_))
+	{
+		_error = "expected: scene output width height spp lookFrom(x y z) lookAt(x y z) vfov aperture focusDist [priority]";
+		return JobLine::Malformed;
+	}
+	_job.LookFrom_ = point3(x, y, z);
+	_job.LookAt_ = point3(ax, ay, az);
+
+	// optional priority, then nothing but an optional comment
+	_job.Priority_ = 0;
+	std::string extra;
+	if (in >> extra && extra[0] != '#')
+	{
+		char* end = nullptr;
+		const long priority = strtol(extra.c_str(), &end, 10);
+		if (end == extra.c_str() || *end != '\0')
+		{
+			_error = "priority must be an integer, not \"" + extra + '"';
+			return JobLine::Malformed;
+		}
+		_job.Priority_ = static_cast<int>(priority);
+		if (in >> extra && extra[0] != '#')
+		{
+			_error = "unexpected \"" + extra + "\" after the priority";
+			return JobLine::Malformed;
+		}
+	}
+
+	if (_job.Width_ <= 0 || _job.Height_ <= 0 || _job.SamplesPerPixel_ <= 0)
+	{
+		_error = "width, height and spp must be positive";
+		return JobLine::Malformed;
+	}
+	return JobLine::Job;
+}
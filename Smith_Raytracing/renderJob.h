@@ -0,0 +1,49 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "rtweekend.h"
+
+#include <string>
+
+/**
+ * \brief One image to render, read from a line of a job list:
+ *	scene output width height spp lookFromX lookFromY lookFromZ lookAtX lookAtY lookAtZ vfov aperture focusDist [priority] [# comment]
+ *	Scene is "random", "random:<seed>", "spheres:<count>" (see RandomSphereSet()), the path of an .obj file or of an
+ *	.rtscene file, which is memory-mapped and rendered out of core (see MappedScene). Generated scenes without a seed
+ *	use the generator's default one, so the same scene string always means the same scene.
+ */
+struct RenderJob
+{
+	// - Members - //
+	std::string Scene_;		// also the key the built scene is cached under
+	std::string Output_;	// .ppm to write
+	int Width_{};
+	int Height_{};
+	int SamplesPerPixel_{};
+	point3 LookFrom_;
+	point3 LookAt_;
+	float VerticalFov_{};	// degrees
+	float Aperture_{};
+	float FocusDist_{};
+	int Priority_{};		// higher renders first
+};
+
+/**
+ * \brief What ParseRenderJob() found on a line
+ */
+enum class JobLine
+{
+	Job,		// a job, returned in _job
+	Skip,		// blank line or comment (#)
+	Malformed	// anything else, described in _error
+};
+
+/**
+ * \brief Parse one line of a job list
+ * \param _line the line
+ * \param _job parsed job
+ * \param _error what's wrong with the line, if it's malformed
+ */
+JobLine ParseRenderJob(const std::string& _line, RenderJob& _job, std::string& _error);
+
+#endif
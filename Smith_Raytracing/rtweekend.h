@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <random>
 
 // - Using - //
 using std::shared_ptr;
@@ -20,14 +21,27 @@ constexpr double pi = 3.1415926535897932385;
 inline double DegToRad(const double _degrees) {
 	return _degrees * pi / 180.0;
 }
+/**
+ * \brief Per-thread random number generator, so render threads never share (or lock) generator state
+ */
+inline std::mt19937& RandomEngine() {
+	thread_local std::mt19937 engine;
+	return engine;
+}
+/**
+ * \brief Restart this thread's random sequence. Same seed, same sequence
+ */
+inline void SeedRandom(unsigned _seed) {
+	RandomEngine().seed(_seed);
+}
 /**
  * \brief Returns a random real number in [0, 1)
  */
 inline double RandomDouble() {
-	return rand() / (RAND_MAX + 1.0);
+	return RandomEngine()() / 4294967296.0;
 }
 inline float RandomFloat() {
-	return rand() / (RAND_MAX + 1.0f);
+	return static_cast<float>(RandomEngine()() >> 8) * (1.0f / 16777216.0f); // top 24 bits, so the result can't round up to 1
 }
 /**
  * \brief returns a number in [min, max)
@@ -0,0 +1,217 @@
+#include "sceneFile.h"
+
+#include "material.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	constexpr char Magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+
+	/**
+	 * \brief Smallest exponent for which 254 steps of 2^exponent cover _extent, leaving a step of slack for rounding
+	 */
+	int QuantizationExponent(float _extent) {
+		if (!(_extent > 0.0f))
+			return -126;
+		int exponent;
+		frexp(_extent / 254.0f, &exponent); // _extent / 254 = m * 2^exponent, m in [0.5, 1)
+		return std::max(-126, std::min(127, exponent));
+	}
+}
+
+std::vector<QuantizedNode> QuantizeNodes(const std::vector<LbvhNode>& _nodes)
+{
+	const size_t internalCount = _nodes.size() / 2;
+	const auto leafOffset = static_cast<uint32_t>(internalCount);
+	std::vector<QuantizedNode> quantized(internalCount);
+
+	for (size_t i = 0; i < internalCount; ++i)
+	{
+		const LbvhNode& node = _nodes[i];
+		QuantizedNode& q = quantized[i];
+		q.Leaves_ = 0;
+		float scale[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			q.Origin_[a] = node.Bounds_.Min_[a];
+			q.Exponent_[a] = static_cast<int8_t>(QuantizationExponent(node.Bounds_.Max_[a] - node.Bounds_.Min_[a]));
+			scale[a] = QuantizedScale(q.Exponent_[a]);
+		}
+
+		const uint32_t children[2] = { node.Left_, node.Right_ };
+		for (int c = 0; c < 2; ++c)
+		{
+			const Aabb& box = _nodes[children[c]].Bounds_;
+			if (children[c] >= leafOffset)
+			{
+				q.Leaves_ |= 1 << c;
+				q.Child_[c] = children[c] - leafOffset;
+			}
+			else
+				q.Child_[c] = children[c];
+
+			// round outwards, checking with the exact expression MappedScene decodes with
+			for (int a = 0; a < 3; ++a)
+			{
+				const auto decode = [&](int _q) { return q.Origin_[a] + static_cast<float>(_q) * scale[a]; };
+				int lo = std::max(0, std::min(255, static_cast<int>(floor((box.Min_[a] - q.Origin_[a]) / scale[a]))));
+				while (lo > 0 && decode(lo) > box.Min_[a])
+					--lo;
+				int hi = std::max(0, std::min(255, static_cast<int>(ceil((box.Max_[a] - q.Origin_[a]) / scale[a]))));
+				while (hi < 255 && decode(hi) < box.Max_[a])
+					++hi;
+				q.Min_[c][a] = static_cast<uint8_t>(lo);
+				q.Max_[c][a] = static_cast<uint8_t>(hi);
+			}
+		}
+	}
+	return quantized;
+}
+
+SceneFileWriter::SceneFileWriter(const std::string& _path, const std::vector<shared_ptr<Material>>& _materials,
+	SceneNodeEncoding _encoding, BvhBuilder _builder)
+	: out_(_path, std::ios::binary | std::ios::trunc), path_(_path), encoding_(_encoding), builder_(_builder), ok_(static_cast<bool>(out_))
+{
+	if (!ok_)
+	{
+		std::cerr << "Couldn't create scene file " << _path << '\n';
+		return;
+	}
+
+	for (const auto& material : _materials)
+	{
+		SceneMaterial record = {};
+		if (const auto* lambertian = dynamic_cast<const Lambertian*>(material.get()))
+		{
+			record.Type_ = SceneMaterial::Lambertian;
+			for (int a = 0; a < 3; ++a)
+				record.Albedo_[a] = lambertian->Albedo_[a];
+		}
+		else if (const auto* metal = dynamic_cast<const Metal*>(material.get()))
+		{
+			record.Type_ = SceneMaterial::Metal;
+			for (int a = 0; a < 3; ++a)
+				record.Albedo_[a] = metal->Albedo_[a];
+			record.Parameter_ = metal->Fuzziness_;
+		}
+		else if (const auto* dielectric = dynamic_cast<const Dielectric*>(material.get()))
+		{
+			record.Type_ = SceneMaterial::Dielectric;
+			record.Parameter_ = dielectric->RefractionIndex_;
+		}
+		else
+		{
+			std::cerr << "Scene file " << _path << ": material " << materials_.size() << " can't be stored\n";
+			ok_ = false;
+			return;
+		}
+		materials_.push_back(record);
+	}
+
+	// the header goes in the first page once everything it points to is known
+	const SceneFileHeader placeholder = {};
+	Write(&placeholder, sizeof(placeholder));
+	PadToBlock();
+}
+
+bool SceneFileWriter::AddChunk(std::vector<SphereSet::Entry> _spheres)
+{
+	if (!ok_ || _spheres.empty())
+		return ok_;
+
+	std::vector<Aabb> boxes(_spheres.size());
+	for (size_t i = 0; i < _spheres.size(); ++i)
+	{
+		const float r = fabs(_spheres[i].Radius_);
+		boxes[i] = Aabb(_spheres[i].Center_ - Vec3(r, r, r), _spheres[i].Center_ + Vec3(r, r, r));
+	}
+	std::vector<uint32_t> order;
+	std::vector<LbvhNode> nodes;
+	const bool log = LogBvhBuilds(); // a line per chunk would bury everything else
+	LogBvhBuilds() = false;
+	BuildBvh(builder_, boxes, order, nodes);
+	LogBvhBuilds() = log;
+
+	SceneChunk chunk = {};
+	for (int a = 0; a < 3; ++a)
+	{
+		chunk.Min_[a] = nodes[0].Bounds_.Min_[a];
+		chunk.Max_[a] = nodes[0].Bounds_.Max_[a];
+	}
+	chunk.SphereCount_ = static_cast<uint32_t>(_spheres.size());
+
+	chunk.NodeOffset_ = offset_;
+	if (encoding_ == SceneNodeEncoding::Quantized)
+	{
+		const std::vector<QuantizedNode> quantized = QuantizeNodes(nodes);
+		chunk.NodeCount_ = static_cast<uint32_t>(quantized.size());
+		Write(quantized.data(), quantized.size() * sizeof(QuantizedNode));
+	}
+	else
+	{
+		chunk.NodeCount_ = static_cast<uint32_t>(nodes.size());
+		Write(nodes.data(), nodes.size() * sizeof(LbvhNode));
+	}
+	PadToBlock();
+
+	// spheres in leaf order, like SphereSet
+	std::vector<SphereSet::Entry> sorted(_spheres.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		sorted[i] = _spheres[order[i]];
+	chunk.SphereOffset_ = offset_;
+	Write(sorted.data(), sorted.size() * sizeof(SphereSet::Entry));
+	PadToBlock();
+
+	chunks_.push_back(chunk);
+	sphereCount_ += _spheres.size();
+	return ok_;
+}
+
+bool SceneFileWriter::Finish()
+{
+	if (!ok_)
+		return false;
+
+	SceneFileHeader header = {};
+	memcpy(header.Magic_, Magic, sizeof(Magic));
+	header.Version_ = SceneFileVersion;
+	header.Encoding_ = static_cast<uint32_t>(encoding_);
+	header.SphereCount_ = sphereCount_;
+	header.ChunkCount_ = chunks_.size();
+	header.ChunkTableOffset_ = offset_; // page aligned, so the records can be read in place
+	Write(chunks_.data(), chunks_.size() * sizeof(SceneChunk));
+	header.MaterialCount_ = materials_.size();
+	header.MaterialOffset_ = offset_;
+	Write(materials_.data(), materials_.size() * sizeof(SceneMaterial));
+
+	out_.seekp(0);
+	out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out_.close();
+	if (!out_)
+	{
+		std::cerr << "Couldn't finish scene file " << path_ << '\n';
+		ok_ = false;
+	}
+	return ok_;
+}
+
+void SceneFileWriter::Write(const void* _data, size_t _bytes)
+{
+	if (!ok_ || _bytes == 0)
+		return;
+	out_.write(static_cast<const char*>(_data), static_cast<std::streamsize>(_bytes));
+	offset_ += _bytes;
+	if (!out_)
+	{
+		std::cerr << "Couldn't write scene file " << path_ << " at byte " << offset_ << '\n';
+		ok_ = false;
+	}
+}
+
+void SceneFileWriter::PadToBlock()
+{
+	static const char zeros[SceneFileBlockAlignment] = {};
+	Write(zeros, static_cast<size_t>((SceneFileBlockAlignment - offset_ % SceneFileBlockAlignment) % SceneFileBlockAlignment));
+}
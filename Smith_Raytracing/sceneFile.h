@@ -0,0 +1,150 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "sphereSet.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * On-disk sphere scene, laid out to be memory-mapped read-only and paged in on demand (see MappedScene):
+ *
+ *	page 0		SceneFileHeader
+ *	...			per chunk, each block starting on a page boundary: the chunk's BVH nodes, then its spheres
+ *	...			one SceneChunk record per chunk, then the SceneMaterial records
+ *
+ * A chunk is a spatially compact group of spheres with its own BVH, in the same layout BuildLbvh() produces.
+ * Chunks are written in the order the writer receives them, which should be Morton order of their position so
+ * that chunks close in space are close in the file as well. Within a chunk, spheres are in their BVH's leaf
+ * (Morton) order, so a ray touches as few pages as possible.
+ */
+
+constexpr uint32_t SceneFileVersion = 1;
+constexpr uint64_t SceneFileBlockAlignment = 4096; // page size, so no block shares a page with another
+
+enum class SceneNodeEncoding : uint32_t
+{
+	Full = 0,		// LbvhNode as is: 2n - 1 nodes of 32 B per n spheres
+	Quantized = 1	// QuantizedNode: n - 1 nodes of 36 B, leaves are implicit
+};
+
+struct SceneFileHeader
+{
+	char Magic_[8];				// "RTSCENE" and a 0
+	uint32_t Version_;			// SceneFileVersion
+	uint32_t Encoding_;			// SceneNodeEncoding
+	uint64_t SphereCount_;
+	uint64_t ChunkCount_;
+	uint64_t ChunkTableOffset_;	// byte offset of ChunkCount_ SceneChunk records
+	uint64_t MaterialCount_;
+	uint64_t MaterialOffset_;	// byte offset of MaterialCount_ SceneMaterial records
+};
+
+struct SceneChunk
+{
+	float Min_[3];			// bounds of every sphere in the chunk
+	float Max_[3];
+	uint32_t SphereCount_;
+	uint32_t NodeCount_;
+	uint64_t NodeOffset_;	// byte offset of the node block, a multiple of SceneFileBlockAlignment
+	uint64_t SphereOffset_;	// byte offset of SphereCount_ SphereSet::Entry records, also page aligned
+};
+
+struct SceneMaterial
+{
+	enum Type : uint32_t { Lambertian = 0, Metal = 1, Dielectric = 2 };
+
+	uint32_t Type_;
+	float Albedo_[3];	// Lambertian and Metal
+	float Parameter_;	// Metal fuzziness or Dielectric refraction index
+};
+
+/**
+ * \brief BVH node that stores its two children's boxes in 8 bits per coordinate, relative to its own box:
+ *	child coordinate = Origin_ + q * 2^Exponent_. Quantization rounds outwards, so a decoded box always encloses
+ *	the exact one. Children flagged in Leaves_ are spheres of the chunk rather than nodes, so no leaf nodes are stored.
+ */
+struct QuantizedNode
+{
+	float Origin_[3];
+	int8_t Exponent_[3];
+	uint8_t Leaves_;		// bit i set: Child_[i] is a sphere index
+	uint8_t Min_[2][3];
+	uint8_t Max_[2][3];
+	uint32_t Child_[2];
+};
+
+static_assert(sizeof(SceneFileHeader) == 56, "scene file header layout changed");
+static_assert(sizeof(SceneChunk) == 48, "scene chunk record layout changed");
+static_assert(sizeof(SceneMaterial) == 20, "scene material record layout changed");
+static_assert(sizeof(QuantizedNode) == 36, "quantized node layout changed");
+static_assert(sizeof(LbvhNode) == 32, "full node layout changed");
+static_assert(sizeof(SphereSet::Entry) == 20, "sphere record layout changed");
+
+/**
+ * \return 2^_exponent, for the exponents a QuantizedNode can hold
+ */
+inline float QuantizedScale(int _exponent) {
+	const uint32_t bits = static_cast<uint32_t>(_exponent + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return scale;
+}
+
+/**
+ * \brief Encode a tree in BuildLbvh()'s layout (n - 1 internal nodes, then n leaves) as n - 1 QuantizedNodes.
+ *	Node indices stay the same and leaf i becomes sphere i
+ */
+std::vector<QuantizedNode> QuantizeNodes(const std::vector<LbvhNode>& _nodes);
+
+/**
+ * \brief Streams a scene file to disk one chunk at a time, so scenes far bigger than memory can be written
+ */
+class SceneFileWriter
+{
+public:
+	// - Constructors - //
+	/**
+	 * \param _path file to create
+	 * \param _materials material table the spheres index into. Only Lambertian, Metal and Dielectric can be stored
+	 * \param _encoding how to store the chunks' BVH nodes
+	 * \param _builder how to build each chunk's BVH
+	 */
+	SceneFileWriter(const std::string& _path, const std::vector<shared_ptr<Material>>& _materials, SceneNodeEncoding _encoding,
+		BvhBuilder _builder = BvhBuilder::Lbvh);
+
+	// - Getters - //
+	bool IsOpen() const { return ok_; }
+	uint64_t BytesWritten() const { return offset_; }
+
+	// - Methods - //
+	/**
+	 * \brief Build a BVH over the spheres and append it and them, in leaf order, as the next chunk
+	 * \return FALSE if writing failed
+	 */
+	bool AddChunk(std::vector<SphereSet::Entry> _spheres);
+	/**
+	 * \brief Write the material and chunk tables and the header. Nothing can be added afterwards
+	 * \return FALSE if writing failed at any point
+	 */
+	bool Finish();
+
+private:
+	void Write(const void* _data, size_t _bytes);
+	void PadToBlock();
+
+	std::ofstream out_;
+	std::string path_;
+	SceneNodeEncoding encoding_;
+	BvhBuilder builder_;
+	std::vector<SceneMaterial> materials_;
+	std::vector<SceneChunk> chunks_;
+	uint64_t sphereCount_ = 0;
+	uint64_t offset_ = 0;
+	bool ok_;
+};
+
+#endif
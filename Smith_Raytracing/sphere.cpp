@@ -1,11 +1,11 @@
 #include "sphere.h"
 
-bool Sphere::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const {
-    Vec3 oc = _r.Origin() - Center_;
+bool Sphere::Intersect(const point3& _center, float _radius, const Ray& _r, float _tMin, float _tMax, float& _t) {
+    Vec3 oc = _r.Origin() - _center;
     auto a = _r.Direction().LengthSquared(); //same as Dot(_r.Direction(), _r.Direction());
     //auto b = 2.0f * Dot(oc, _r.Direction());
     auto halfB = Dot(oc, _r.Direction());
-    auto c = oc.LengthSquared() - Radius_ * Radius_; // same as Dot(oc, oc) - _radius * _radius;
+    auto c = oc.LengthSquared() - _radius * _radius; // same as Dot(oc, oc) - _radius * _radius;
 
 
     //auto discriminant = b * b - 4 * a * c; // the part under the radical in the quadratic formula
@@ -30,6 +30,15 @@ bool Sphere::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const
         }
     }
 
+    _t = root;
+    return true;
+}
+
+bool Sphere::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const {
+    float root;
+    if (!Intersect(Center_, Radius_, _r, _tMin, _tMax, root))
+        return false;
+
     // Hit! Update the record struct with details about the hit
     _info.T_ = root;
     _info.P_ = _r.At(_info.T_);
@@ -38,3 +47,9 @@ bool Sphere::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const
     _info.MaterialPtr_ = MaterialPtr_;
     return true;
 }
+
+bool Sphere::BoundingBox(Aabb& _outBox) const {
+    const float r = fabs(Radius_); // negative radii are used for hollow glass, the bounds are the same
+    _outBox = Aabb(Center_ - Vec3(r, r, r), Center_ + Vec3(r, r, r));
+    return true;
+}
\ No newline at end of file
@@ -17,7 +17,15 @@ struct Sphere : public Hittable
 		: Center_(_center), Radius_(_radius), MaterialPtr_(std::move(_mat)) {}
 
 	// - Methods - //
+	/**
+	 * \brief Ray/sphere test shared by everything that stores spheres
+	 * \param _t lerp distance of the nearest intersection in [_tMin, _tMax]
+	 * \return TRUE if there is one
+	 */
+	static bool Intersect(const point3& _center, float _radius, const Ray& _r, float _tMin, float _tMax, float& _t);
 	bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const override;
+	bool BoundingBox(Aabb& _outBox) const override;
+	shared_ptr<Hittable> Replicate() const override { return make_shared<Sphere>(*this); }
 };
 
 #endif
@@ -0,0 +1,55 @@
+#include "sphereSet.h"
+
+#include "sphere.h"
+
+SphereSet::SphereSet(std::vector<Entry> _spheres, std::vector<shared_ptr<Material>> _materials, BvhBuilder _builder)
+	: materials_(std::move(_materials))
+{
+	if (_spheres.empty())
+		return;
+
+	std::vector<Aabb> boxes(_spheres.size());
+	for (size_t i = 0; i < _spheres.size(); ++i)
+	{
+		const float r = fabs(_spheres[i].Radius_);
+		boxes[i] = Aabb(_spheres[i].Center_ - Vec3(r, r, r), _spheres[i].Center_ + Vec3(r, r, r));
+	}
+
+	std::vector<uint32_t> order;
+	BuildBvh(_builder, boxes, order, nodes_);
+
+	spheres_.resize(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		spheres_[i] = _spheres[order[i]];
+}
+
+bool SphereSet::BoundingBox(Aabb& _outBox) const
+{
+	if (nodes_.empty())
+		return false;
+	_outBox = nodes_[0].Bounds_;
+	return true;
+}
+
+bool SphereSet::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const
+{
+	float closestSoFar = _tMax;
+	uint32_t sphereHit = 0;
+
+	const bool hitAnything = TraverseLbvh(nodes_, _r, _tMin, closestSoFar, [&](uint32_t _leaf, float& _closest) {
+		if (!Sphere::Intersect(spheres_[_leaf].Center_, spheres_[_leaf].Radius_, _r, _tMin, _closest, _closest))
+			return false;
+		sphereHit = _leaf;
+		return true;
+	});
+	if (!hitAnything)
+		return false;
+
+	// Hit! Only fill in the record once, for the closest sphere
+	const Entry& sphere = spheres_[sphereHit];
+	_info.T_ = closestSoFar;
+	_info.P_ = _r.At(_info.T_);
+	_info.SetFaceNormal(_r, (_info.P_ - sphere.Center_) / sphere.Radius_);
+	_info.MaterialPtr_ = materials_[sphere.Material_];
+	return true;
+}
@@ -0,0 +1,51 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "linearBvh.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Many spheres stored by value in one array, with a shared material table and a BVH over them.
+ *	Compared to a HittableList of Spheres there is no allocation (or shared_ptr, or vtable) per sphere, and the
+ *	array is kept in the BVH's Morton order so spheres that are close in space are close in memory too.
+ */
+struct SphereSet : public Hittable
+{
+	struct Entry
+	{
+		point3 Center_;
+		float Radius_;
+		uint32_t Material_;	// index into the material table
+	};
+
+	// - Constructors - //
+	SphereSet(std::vector<Entry> _spheres, std::vector<shared_ptr<Material>> _materials, BvhBuilder _builder = BvhBuilder::LbvhTreelets);
+
+	// - Getters - //
+	size_t SphereCount() const { return spheres_.size(); }
+	float SahCost() const { return nodes_.empty() ? 0.0f : LbvhSahCost(nodes_); }
+	int Depth() const { return LbvhDepth(nodes_); }
+	Aabb SphereBounds(size_t _index) const {
+		const Entry& s = spheres_[_index];
+		const float r = fabs(s.Radius_);
+		return Aabb(s.Center_ - Vec3(r, r, r), s.Center_ + Vec3(r, r, r));
+	}
+	/**
+	 * \return heap footprint of the spheres and BVH in bytes
+	 */
+	size_t MemoryUsage() const { return spheres_.capacity() * sizeof(Entry) + nodes_.capacity() * sizeof(LbvhNode); }
+
+	// - Methods - //
+	bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const override;
+	bool BoundingBox(Aabb& _outBox) const override;
+	shared_ptr<Hittable> Replicate() const override { return make_shared<SphereSet>(*this); }
+
+private:
+	std::vector<Entry> spheres_;	// in leaf order
+	std::vector<shared_ptr<Material>> materials_;
+	std::vector<LbvhNode> nodes_;
+};
+
+#endif
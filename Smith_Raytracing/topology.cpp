@@ -0,0 +1,117 @@
+#include "topology.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	/**
+	 * \brief Parse a sysfs CPU list such as "0-3,8-11"
+	 */
+	std::vector<int> ParseCpuList(const std::string& _list) {
+		std::vector<int> cpus;
+		size_t pos = 0;
+		while (pos < _list.size())
+		{
+			size_t end = _list.find(',', pos);
+			if (end == std::string::npos)
+				end = _list.size();
+			const std::string range = _list.substr(pos, end - pos);
+			const size_t dash = range.find('-');
+			const int first = atoi(range.c_str());
+			const int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+			if (!range.empty() && range[0] >= '0' && range[0] <= '9')
+			{
+				for (int cpu = first; cpu <= last; ++cpu)
+					cpus.push_back(cpu);
+			}
+			pos = end + 1;
+		}
+		return cpus;
+	}
+
+	/**
+	 * \brief CPUs the calling process is allowed to run on
+	 * \return empty if unknown
+	 */
+	std::vector<int> AllowedCpus() {
+		std::vector<int> cpus;
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				if (CPU_ISSET(cpu, &set))
+					cpus.push_back(cpu);
+			}
+		}
+#endif
+		return cpus;
+	}
+}
+
+CpuTopology DetectTopology()
+{
+	CpuTopology topology;
+	const std::vector<int> allowed = AllowedCpus();
+
+	// node ids are usually dense, but stop after a run of missing ones rather than assuming
+	for (int node = 0, missing = 0; missing < 8; ++node)
+	{
+		std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string list;
+		if (!file || !std::getline(file, list))
+		{
+			++missing;
+			continue;
+		}
+		missing = 0;
+		std::vector<int> cpus = ParseCpuList(list);
+		if (!allowed.empty())
+		{
+			cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+				[&](int _cpu) { return !std::binary_search(allowed.begin(), allowed.end(), _cpu); }), cpus.end());
+		}
+		if (!cpus.empty()) // memory-only nodes, or ones this process is kept off, have no CPUs to run on
+		{
+			topology.NodeCpus_.push_back(std::move(cpus));
+			topology.NodeIds_.push_back(node);
+		}
+	}
+
+	if (topology.NodeCpus_.empty())
+	{
+		topology.NodeCpus_.push_back(allowed);
+		topology.NodeIds_.push_back(0);
+		if (allowed.empty())
+		{
+			for (unsigned cpu = 0; cpu < ThreadCount(); ++cpu)
+				topology.NodeCpus_[0].push_back(static_cast<int>(cpu));
+		}
+	}
+	return topology;
+}
+
+bool PinCurrentThread(int _cpu)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(_cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)_cpu;
+	return false;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * \brief Which logical CPUs belong to which NUMA node
+ */
+struct CpuTopology
+{
+	std::vector<std::vector<int>> NodeCpus_;	// NodeCpus_[node] = CPU ids on that node
+	std::vector<int> NodeIds_;					// NodeIds_[node] = the node's id in sysfs, which skips nodes without CPUs
+
+	size_t CpuCount() const {
+		size_t count = 0;
+		for (const auto& cpus : NodeCpus_)
+			count += cpus.size();
+		return count;
+	}
+};
+
+/**
+ * \brief Read the NUMA layout from sysfs (/sys/devices/system/node), keeping only the CPUs this process may run on
+ *	(taskset, cgroup cpusets). Where that isn't available (not Linux, no NUMA support) everything is reported as a
+ *	single node holding the allowed CPUs, or std::thread::hardware_concurrency() of them if those are unknown too
+ */
+CpuTopology DetectTopology();
+
+/**
+ * \brief Restrict the calling thread to one logical CPU
+ * \return FALSE if pinning isn't supported here or failed
+ */
+bool PinCurrentThread(int _cpu);
+
+#endif
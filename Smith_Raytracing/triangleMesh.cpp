@@ -0,0 +1,240 @@
+#include "triangleMesh.h"
+
+#include <algorithm>
+
+TriangleMesh::TriangleMesh(std::vector<point3> _vertices, std::vector<uint32_t> _indices, shared_ptr<Material> _mat)
+	: Vertices_(std::move(_vertices)), Indices_(std::move(_indices)), MaterialPtr_(std::move(_mat))
+{
+	BuildBvh();
+}
+
+size_t TriangleMesh::MemoryUsage() const
+{
+	return Vertices_.capacity() * sizeof(point3)
+		+ Indices_.capacity() * sizeof(uint32_t)
+		+ nodes_.capacity() * sizeof(BvhNode)
+		+ packets_.capacity() * sizeof(TrianglePacket);
+}
+
+void TriangleMesh::BuildBvh()
+{
+	nodes_.clear();
+	packets_.clear();
+
+	const size_t triCount = TriangleCount();
+	if (triCount == 0)
+		return;
+
+	std::vector<uint32_t> tris(triCount);
+	std::vector<point3> centroids(triCount);
+	for (size_t i = 0; i < triCount; ++i)
+	{
+		tris[i] = static_cast<uint32_t>(i);
+		centroids[i] = (Vertices_[Indices_[3 * i]] + Vertices_[Indices_[3 * i + 1]] + Vertices_[Indices_[3 * i + 2]]) / 3.0f;
+	}
+
+	// a binary tree with ceil(n / Width) leaves has at most twice that many nodes
+	const size_t leafCount = (triCount + TrianglePacket::Width - 1) / TrianglePacket::Width;
+	nodes_.reserve(2 * leafCount);
+	packets_.reserve(leafCount);
+
+	nodes_.push_back(BvhNode());
+	BuildNode(0, tris, centroids, 0, triCount);
+}
+
+void TriangleMesh::BuildNode(uint32_t _nodeIndex, std::vector<uint32_t>& _tris, const std::vector<point3>& _centroids, size_t _begin, size_t _end)
+{
+	Aabb bounds;
+	Aabb centroidBounds;
+	for (size_t i = _begin; i < _end; ++i)
+	{
+		const uint32_t tri = _tris[i];
+		bounds.Extend(Vertices_[Indices_[3 * tri]]);
+		bounds.Extend(Vertices_[Indices_[3 * tri + 1]]);
+		bounds.Extend(Vertices_[Indices_[3 * tri + 2]]);
+		centroidBounds.Extend(_centroids[tri]);
+	}
+	nodes_[_nodeIndex].Bounds_ = bounds;
+
+	// Small enough to fit in one packet? make a leaf
+	const size_t count = _end - _begin;
+	if (count <= TrianglePacket::Width)
+	{
+		nodes_[_nodeIndex].IsLeaf_ = 1;
+		nodes_[_nodeIndex].LeftOrPacket_ = static_cast<uint32_t>(packets_.size());
+		packets_.push_back(MakePacket(&_tris[_begin], count));
+		return;
+	}
+
+	// Otherwise split near the median centroid along the widest axis. The left half is rounded up to a whole
+	// number of packets so leaves come out full instead of 2-3 triangles wide
+	const int axis = centroidBounds.LongestAxis();
+	const size_t W = TrianglePacket::Width;
+	const size_t mid = _begin + (count / 2 + W - 1) / W * W;
+	std::nth_element(_tris.begin() + _begin, _tris.begin() + mid, _tris.begin() + _end,
+		[&](uint32_t _a, uint32_t _b) { return _centroids[_a][axis] < _centroids[_b][axis]; });
+
+	// children are allocated side by side so the right child is always left + 1
+	const auto left = static_cast<uint32_t>(nodes_.size());
+	nodes_.push_back(BvhNode());
+	nodes_.push_back(BvhNode());
+	nodes_[_nodeIndex].IsLeaf_ = 0;
+	nodes_[_nodeIndex].LeftOrPacket_ = left;
+
+	BuildNode(left, _tris, _centroids, _begin, mid);
+	BuildNode(left + 1, _tris, _centroids, mid, _end);
+}
+
+TrianglePacket TriangleMesh::MakePacket(const uint32_t* _tris, size_t _count) const
+{
+	TrianglePacket packet{};
+	for (size_t lane = 0; lane < _count; ++lane)
+	{
+		const uint32_t tri = _tris[lane];
+		const point3& v0 = Vertices_[Indices_[3 * tri]];
+		const point3& v1 = Vertices_[Indices_[3 * tri + 1]];
+		const point3& v2 = Vertices_[Indices_[3 * tri + 2]];
+		for (int a = 0; a < 3; ++a)
+		{
+			packet.V0_[a][lane] = v0[a];
+			packet.V1_[a][lane] = v1[a];
+			packet.V2_[a][lane] = v2[a];
+		}
+		packet.TriIndex_[lane] = tri;
+	}
+	return packet;
+}
+
+bool TriangleMesh::HitPacket(const TrianglePacket& _packet, const ShearedRay& _ray, float _tMin, float& _tClosest, uint32_t& _triHit)
+{
+	// Watertight ray/triangle test (Woop, Benthin, Wald 2013). Corners are moved into a space where the ray
+	// starts at the origin and runs along +z; the hit test is then 2D edge functions U, V, W that depend only on
+	// the two corners of each edge, so both triangles sharing an edge evaluate it identically and no ray can
+	// slip between them.
+	constexpr int W = TrianglePacket::Width;
+	const int kx = _ray.Kx_, ky = _ray.Ky_, kz = _ray.Kz_;
+	const float sx = _ray.Sx_, sy = _ray.Sy_, sz = _ray.Sz_;
+	const float ox = _ray.Origin_[kx], oy = _ray.Origin_[ky], oz = _ray.Origin_[kz];
+	const float* v0x = _packet.V0_[kx]; const float* v0y = _packet.V0_[ky]; const float* v0z = _packet.V0_[kz];
+	const float* v1x = _packet.V1_[kx]; const float* v1y = _packet.V1_[ky]; const float* v1z = _packet.V1_[kz];
+	const float* v2x = _packet.V2_[kx]; const float* v2y = _packet.V2_[ky]; const float* v2z = _packet.V2_[kz];
+
+	// Every lane, no early-outs, so the compiler can vectorize the loop
+	float uLane[W], vLane[W], wLane[W], tScaled[W];
+	for (int i = 0; i < W; ++i)
+	{
+		// corners relative to the ray origin, sheared so the ray direction is +z
+		const float az = v0z[i] - oz, bz = v1z[i] - oz, cz = v2z[i] - oz;
+		const float ax = (v0x[i] - ox) - sx * az, ay = (v0y[i] - oy) - sy * az;
+		const float bx = (v1x[i] - ox) - sx * bz, by = (v1y[i] - oy) - sy * bz;
+		const float cx = (v2x[i] - ox) - sx * cz, cy = (v2y[i] - oy) - sy * cz;
+
+		// scaled barycentrics: which side of each edge the ray passes
+		uLane[i] = cx * by - cy * bx;
+		vLane[i] = ax * cy - ay * cx;
+		wLane[i] = bx * ay - by * ax;
+		tScaled[i] = uLane[i] * (sz * az) + vLane[i] * (sz * bz) + wLane[i] * (sz * cz);
+	}
+
+	bool hitAnything = false;
+	for (int i = 0; i < W; ++i)
+	{
+		float u = uLane[i], v = vLane[i], w = wLane[i];
+
+		// exactly on an edge in float: redo the edge functions in double so the sign is decided consistently
+		if (u == 0.0f || v == 0.0f || w == 0.0f)
+		{
+			const double az = v0z[i] - oz, bz = v1z[i] - oz, cz = v2z[i] - oz;
+			const double ax = (v0x[i] - ox) - sx * az, ay = (v0y[i] - oy) - sy * az;
+			const double bx = (v1x[i] - ox) - sx * bz, by = (v1y[i] - oy) - sy * bz;
+			const double cx = (v2x[i] - ox) - sx * cz, cy = (v2y[i] - oy) - sy * cz;
+			u = static_cast<float>(cx * by - cy * bx);
+			v = static_cast<float>(ax * cy - ay * cx);
+			w = static_cast<float>(bx * ay - by * ax);
+			tScaled[i] = static_cast<float>(u * (sz * az) + v * (sz * bz) + w * (sz * cz));
+		}
+
+		// mixed signs: the ray passes outside. Edges themselves (0) count as inside
+		if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+			continue;
+		const float det = u + v + w;
+		if (det == 0.0f) // ray parallel to the triangle, or an empty lane
+			continue;
+
+		const float t = tScaled[i] / det;
+		if (t < _tMin || t > _tClosest)
+			continue;
+
+		_tClosest = t;
+		_triHit = _packet.TriIndex_[i];
+		hitAnything = true;
+	}
+	return hitAnything;
+}
+
+bool TriangleMesh::BoundingBox(Aabb& _outBox) const
+{
+	if (nodes_.empty())
+		return false;
+	_outBox = nodes_[0].Bounds_;
+	return true;
+}
+
+bool TriangleMesh::Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const
+{
+	if (nodes_.empty())
+		return false;
+
+	const Vec3 invDir(1.0f / _r.Direction_.X(), 1.0f / _r.Direction_.Y(), 1.0f / _r.Direction_.Z());
+
+	// watertight test setup: z = the axis the ray moves along fastest, x/y swapped if needed to keep the winding
+	ShearedRay ray;
+	const Vec3& dir = _r.Direction_;
+	ray.Kz_ = fabs(dir.X()) > fabs(dir.Y()) ? (fabs(dir.X()) > fabs(dir.Z()) ? 0 : 2) : (fabs(dir.Y()) > fabs(dir.Z()) ? 1 : 2);
+	ray.Kx_ = (ray.Kz_ + 1) % 3;
+	ray.Ky_ = (ray.Kx_ + 1) % 3;
+	if (dir[ray.Kz_] < 0.0f)
+		std::swap(ray.Kx_, ray.Ky_);
+	ray.Sx_ = dir[ray.Kx_] / dir[ray.Kz_];
+	ray.Sy_ = dir[ray.Ky_] / dir[ray.Kz_];
+	ray.Sz_ = 1.0f / dir[ray.Kz_];
+	ray.Origin_ = _r.Origin_;
+	float closestSoFar = _tMax;
+	uint32_t triHit = 0;
+	bool hitAnything = false;
+
+	// depth-first traversal with an explicit stack. 64 entries covers any tree our median split can produce
+	uint32_t stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BvhNode& node = nodes_[stack[--stackSize]];
+		if (!node.Bounds_.Hit(_r, invDir, _tMin, closestSoFar))
+			continue;
+
+		if (node.IsLeaf_)
+		{
+			if (HitPacket(packets_[node.LeftOrPacket_], ray, _tMin, closestSoFar, triHit))
+				hitAnything = true;
+		}
+		else
+		{
+			stack[stackSize++] = node.LeftOrPacket_;
+			stack[stackSize++] = node.LeftOrPacket_ + 1;
+		}
+	}
+
+	if (!hitAnything)
+		return false;
+
+	// Hit! Update the record struct with details about the closest triangle
+	const point3& v0 = Vertices_[Indices_[3 * triHit]];
+	const point3& v1 = Vertices_[Indices_[3 * triHit + 1]];
+	const point3& v2 = Vertices_[Indices_[3 * triHit + 2]];
+	_info.T_ = closestSoFar;
+	_info.P_ = _r.At(_info.T_);
+	_info.SetFaceNormal(_r, UnitVector(Cross(v1 - v0, v2 - v0)));
+	_info.MaterialPtr_ = MaterialPtr_;
+	return true;
+}
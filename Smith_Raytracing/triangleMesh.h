@@ -0,0 +1,83 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "aabb.h"
+#include "hittable.h"
+
+#include <cstdint>
+#include <vector>
+
+// Triangles tested per packet: 4 (SSE-sized) or 8 (AVX-sized). Override with /D or -D RT_TRIANGLE_PACKET_WIDTH=8
+#ifndef RT_TRIANGLE_PACKET_WIDTH
+#define RT_TRIANGLE_PACKET_WIDTH 4
+#endif
+
+/**
+ * \brief A few triangles stored component-by-component (SoA) so one intersection pass tests all of them at once.
+ *	Unused lanes hold a degenerate triangle (all corners equal) which can never be hit.
+ */
+struct TrianglePacket
+{
+	static constexpr int Width = RT_TRIANGLE_PACKET_WIDTH;
+	static_assert(Width == 4 || Width == 8, "RT_TRIANGLE_PACKET_WIDTH must be 4 or 8");
+
+	float V0_[3][Width];	// corners, per axis
+	float V1_[3][Width];
+	float V2_[3][Width];
+	uint32_t TriIndex_[Width];	// which triangle of the mesh each lane holds
+};
+
+/**
+ * \brief Indexed triangle mesh with a shared vertex buffer and its own BVH
+ */
+struct TriangleMesh : public Hittable
+{
+	// - Members - //
+	std::vector<point3> Vertices_;
+	std::vector<uint32_t> Indices_;	// 3 per triangle, into Vertices_
+	shared_ptr<Material> MaterialPtr_;
+
+	// - Constructors - //
+	TriangleMesh(std::vector<point3> _vertices, std::vector<uint32_t> _indices, shared_ptr<Material> _mat);
+
+	// - Getters - //
+	size_t TriangleCount() const { return Indices_.size() / 3; }
+	/**
+	 * \return approximate heap footprint of the mesh (vertices, indices, BVH and packets) in bytes
+	 */
+	size_t MemoryUsage() const;
+
+	// - Methods - //
+	bool Hit(const Ray& _r, float _tMin, float _tMax, HitInfo& _info) const override;
+	bool BoundingBox(Aabb& _outBox) const override;
+	shared_ptr<Hittable> Replicate() const override { return make_shared<TriangleMesh>(*this); }
+
+private:
+	struct BvhNode
+	{
+		Aabb Bounds_;
+		uint32_t LeftOrPacket_;	// interior: index of left child (right child is LeftOrPacket_ + 1). leaf: packet index
+		uint32_t IsLeaf_;
+	};
+
+	std::vector<BvhNode> nodes_;
+	std::vector<TrianglePacket> packets_;
+
+	/**
+	 * \brief Per-ray setup for the watertight test: the ray's dominant axis becomes z, and the shear that maps
+	 *	the ray direction onto +z
+	 */
+	struct ShearedRay
+	{
+		int Kx_, Ky_, Kz_;
+		float Sx_, Sy_, Sz_;
+		point3 Origin_;
+	};
+
+	void BuildBvh();
+	void BuildNode(uint32_t _nodeIndex, std::vector<uint32_t>& _tris, const std::vector<point3>& _centroids, size_t _begin, size_t _end);
+	TrianglePacket MakePacket(const uint32_t* _tris, size_t _count) const;
+	static bool HitPacket(const TrianglePacket& _packet, const ShearedRay& _ray, float _tMin, float& _tClosest, uint32_t& _triHit);
+};
+
+#endif
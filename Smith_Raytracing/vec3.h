@@ -4,6 +4,7 @@
 #include <cmath>
 #include <iostream>
 
+#include "fastMath.h"
 #include "rtweekend.h"
 
 using std::sqrt;
@@ -114,14 +115,52 @@ inline Vec3 Reflect(const Vec3 _v, const Vec3& _norm) {
 	return _v - 2 * Dot(_v, _norm) * _norm;
 }
 inline Vec3 Refract(const Vec3& _uv, const Vec3& _norm, float _etaiOverEtat) {
+#ifdef RT_FAST_MATH
+	const float cosUv = Dot(-_uv, _norm);
+	const auto cosTheta = cosUv < 1.0f ? cosUv : 1.0f;
+	Vec3 rPerp = _etaiOverEtat * (_uv + cosTheta * _norm);
+	const float parallelSquared = 1.0f - rPerp.LengthSquared();
+	Vec3 rParallel = -sqrt(parallelSquared > 0.0f ? parallelSquared : -parallelSquared) * _norm;
+#else
 	auto cosTheta = fmin(Dot(-_uv, _norm), 1.0f);
 	Vec3 rPerp = _etaiOverEtat * (_uv + cosTheta * _norm);
 	Vec3 rParallel = -sqrt(fabs(1.0f - rPerp.LengthSquared())) * _norm;
+#endif
 	return rPerp + rParallel;
 }
 inline Vec3 UnitVector(Vec3 _v) {
+#ifdef RT_FAST_MATH
+	return _v * FastRsqrt(_v.LengthSquared());
+#else
 	return _v / _v.Length();
+#endif
+}
+#ifdef RT_FAST_MATH
+// Closed-form samplers: no rejection loop, so a fixed number of random numbers and no unpredictable branch
+inline Vec3 RandomUnitVector() {
+	// uniform z and angle around it give a uniform direction (Archimedes' hat-box theorem)
+	const float z = 1.0f - 2.0f * RandomFloat();
+	const float rSquared = 1.0f - z * z;
+	const float r = sqrt(rSquared > 0.0f ? rSquared : 0.0f);
+	float c, s;
+	FastSinCosTurns(RandomFloat(), c, s);
+	return { r * c, r * s, z };
 }
+inline Vec3 RandomInUnitSphere() {
+	// radius needs CDF r^3, which is exactly the distribution of the largest of three uniforms
+	const float a = RandomFloat(), b = RandomFloat(), c = RandomFloat();
+	const float radius = a > b ? (a > c ? a : c) : (b > c ? b : c);
+	return radius * RandomUnitVector();
+}
+inline Vec3 RandomInUnitDisk() {
+	// radius needs CDF r^2: the larger of two uniforms
+	const float a = RandomFloat(), b = RandomFloat();
+	const float radius = a > b ? a : b;
+	float c, s;
+	FastSinCosTurns(RandomFloat(), c, s);
+	return { radius * c, radius * s, 0 };
+}
+#else
 inline Vec3 RandomInUnitSphere() {
 	while (true)
 	{
@@ -141,6 +180,7 @@ inline Vec3 RandomInUnitDisk() {
 inline Vec3 RandomUnitVector() {
 	return UnitVector(RandomInUnitSphere());
 }
+#endif
 inline Vec3 RandomInHemisphere(const Vec3& _normal) {
 	const Vec3 inUnitHemisphere = RandomInUnitSphere();
 	if (Dot(inUnitHemisphere, _normal) > 0.0f)